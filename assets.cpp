@@ -0,0 +1,194 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <iostream>
+#include <climits>
+#include <cstdlib>
+#include <sys/stat.h>
+#include "tgaimage.h"
+#include "model.h"
+#include "meshopt.h"
+#include "bvh.h"
+#include "threadpool.h"
+#include "trace.h"
+#include "assets.h"
+
+AssetCache::AssetCache(size_t budget_bytes) : mutex_(), entries_(), lru_(), budget_(budget_bytes) {
+	stats_.hits = stats_.misses = stats_.evictions = 0;
+	stats_.resident_bytes = 0;
+}
+
+static AssetCache::Asset load_model(const std::string& path, size_t& bytes) {
+	Model* m = new Model(path.c_str());
+	if (m->nfaces()==0) {
+		delete m;
+		return AssetCache::Asset();
+	}
+	optimize_mesh(m);
+	build_bvh(m);
+	bytes = m->bytes();
+	return std::shared_ptr<const Model>(m);
+}
+
+static AssetCache::Asset load_compact_model(const std::string& path, size_t& bytes) {
+	Model m(path.c_str());
+	if (m.nfaces()==0) return AssetCache::Asset();
+	optimize_mesh(&m);
+	CompactMesh* c = new CompactMesh(m);
+	bytes = c->bytes();
+	return std::shared_ptr<const CompactMesh>(c);
+}
+
+static AssetCache::Asset load_texture(const std::string& path, size_t& bytes) {
+	TGAImage* t = new TGAImage();
+	// decoded bottom row first, so v=0 is the bottom without a flip pass
+	if (!t->read_file(path.c_str(), true)) {
+		delete t;
+		return AssetCache::Asset();
+	}
+	bytes = sizeof(TGAImage) + (size_t)t->get_width()*t->get_height()*t->get_bytespp();
+	return std::shared_ptr<const TGAImage>(t);
+}
+
+static AssetCache::Asset load_compressed_texture(const std::string& path, bool normal_map, size_t& bytes) {
+	TGAImage t;
+	if (!t.read_file(path.c_str(), true)) return AssetCache::Asset();
+	BCTexture* bc = normal_map ? new BCTexture(t, BCTexture::BC5) : new BCTexture(t);
+	bytes = bc->bytes();
+	return std::shared_ptr<const BCTexture>(bc);
+}
+
+ModelHandle AssetCache::model(const std::string& path) {
+	return std::static_pointer_cast<const Model>(get("model", path, load_model));
+}
+
+CompactMeshHandle AssetCache::compact_model(const std::string& path) {
+	return std::static_pointer_cast<const CompactMesh>(get("compactmesh", path, load_compact_model));
+}
+
+TextureHandle AssetCache::texture(const std::string& path) {
+	return std::static_pointer_cast<const TGAImage>(get("texture", path, load_texture));
+}
+
+CompressedTextureHandle AssetCache::compressed_texture(const std::string& path, bool normal_map) {
+	return std::static_pointer_cast<const BCTexture>(get(normal_map ? "bctexture_nm" : "bctexture", path, [normal_map](const std::string& p, size_t& bytes) {
+		return load_compressed_texture(p, normal_map, bytes);
+	}));
+}
+
+// runs get() on pool and hands what it returns to the future
+template <class Handle> static std::shared_future<Handle> start_load(ThreadPool& pool, std::function<Handle()> get) {
+	std::shared_ptr<std::promise<Handle>> promise = std::make_shared<std::promise<Handle>>();
+	std::shared_future<Handle> loaded = promise->get_future().share();
+	pool.submit([promise, get]() {
+		trace_thread_name("loader");
+		// a throw goes to whoever waits on the future, the pool's thread has nowhere to put it
+		try {
+			promise->set_value(get());
+		} catch (...) {
+			promise->set_exception(std::current_exception());
+		}
+	});
+	return loaded;
+}
+
+std::shared_future<ModelHandle> AssetCache::model_async(const std::string& path, ThreadPool& pool) {
+	return start_load<ModelHandle>(pool, [this, path]() { return model(path); });
+}
+
+std::shared_future<TextureHandle> AssetCache::texture_async(const std::string& path, ThreadPool& pool) {
+	return start_load<TextureHandle>(pool, [this, path]() { return texture(path); });
+}
+
+std::shared_future<CompressedTextureHandle> AssetCache::compressed_texture_async(const std::string& path, ThreadPool& pool, bool normal_map) {
+	return start_load<CompressedTextureHandle>(pool, [this, path, normal_map]() { return compressed_texture(path, normal_map); });
+}
+
+AssetCache::Asset AssetCache::get(const std::string& kind, const std::string& path, Loader load) {
+	char real[PATH_MAX];
+	struct stat st;
+	if (!realpath(path.c_str(), real) || stat(real, &st)!=0) {
+		std::cerr << "can't open file " << path << "\n";
+		return Asset();
+	}
+	std::string key = kind + ":" + real;
+
+	std::promise<Asset> promise;
+	std::shared_future<Asset> cached;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::map<std::string, Entry>::iterator it = entries_.find(key);
+		if (it!=entries_.end() && (it->second.mtime_sec!=st.st_mtim.tv_sec || it->second.mtime_nsec!=st.st_mtim.tv_nsec)) {
+			// the file changed. handles to the old version stay valid, new callers get a fresh load
+			if (!it->second.loading) {
+				stats_.resident_bytes -= it->second.bytes;
+				lru_.erase(it->second.lru);
+				entries_.erase(it);
+				it = entries_.end();
+			}
+		}
+		if (it!=entries_.end()) {
+			stats_.hits++;
+			lru_.splice(lru_.begin(), lru_, it->second.lru);
+			cached = it->second.asset;
+		} else {
+			stats_.misses++;
+			Entry e;
+			e.asset = promise.get_future().share();
+			e.mtime_sec = st.st_mtim.tv_sec;
+			e.mtime_nsec = st.st_mtim.tv_nsec;
+			e.bytes = 0;
+			e.loading = true;
+			lru_.push_front(key);
+			e.lru = lru_.begin();
+			entries_[key] = e;
+		}
+	}
+	// waits if another thread is still loading it
+	if (cached.valid()) return cached.get();
+
+	size_t bytes = 0;
+	Asset a = load(real, bytes);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::map<std::string, Entry>::iterator it = entries_.find(key);
+		if (!a) {
+			// don't remember failures, the next caller tries again
+			lru_.erase(it->second.lru);
+			entries_.erase(it);
+		} else {
+			it->second.bytes = bytes;
+			it->second.loading = false;
+			stats_.resident_bytes += bytes;
+		}
+		promise.set_value(a);
+		evict();
+	}
+	return a;
+}
+
+// drops least recently used entries until we're under budget. entries still loading or
+// still handed out are skipped since dropping them wouldn't free anything
+void AssetCache::evict() {
+	std::list<std::string>::iterator it = lru_.end();
+	while (stats_.resident_bytes>budget_ && it!=lru_.begin()) {
+		--it;
+		std::map<std::string, Entry>::iterator e = entries_.find(*it);
+		if (e->second.loading || e->second.asset.get().use_count()>1) continue;
+		stats_.resident_bytes -= e->second.bytes;
+		stats_.evictions++;
+		entries_.erase(e);
+		it = lru_.erase(it);
+	}
+}
+
+void AssetCache::set_budget(size_t budget_bytes) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	budget_ = budget_bytes;
+	evict();
+}
+
+AssetCache::Stats AssetCache::stats() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
@@ -0,0 +1,84 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_ASSETS_H
+#define TATE_ASSETS_H
+
+#include <string>
+#include <map>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <future>
+#include <functional>
+#include "tgaimage.h"
+#include "model.h"
+#include "bctexture.h"
+#include "compactmesh.h"
+
+class ThreadPool;
+
+typedef std::shared_ptr<const Model> ModelHandle;
+typedef std::shared_ptr<const TGAImage> TextureHandle;
+typedef std::shared_ptr<const BCTexture> CompressedTextureHandle;
+typedef std::shared_ptr<const CompactMesh> CompactMeshHandle;
+
+const size_t ASSET_BUDGET = 256u<<20; // default resident byte budget
+const int ASSET_LOADERS = 4;           // threads in a loader pool, one file each
+
+// shared, read only models and textures keyed by canonical path and modification time.
+// a file asked for by several threads at once is only loaded once. when the loaded assets
+// go over the byte budget the least recently used ones that nobody holds a handle to are dropped
+class AssetCache {
+public:
+	struct Stats {
+		long hits, misses, evictions;
+		size_t resident_bytes;
+	};
+	AssetCache(size_t budget_bytes=ASSET_BUDGET);
+	AssetCache(const AssetCache&) = delete;
+	AssetCache& operator=(const AssetCache&) = delete;
+
+	// empty handle if the file can't be read. models come back with meshlets and bvh built,
+	// textures come back flipped so v=0 is the bottom row
+	ModelHandle model(const std::string& path);
+	// quantized copy of the model, faces in the same meshlet order. the full model isn't kept
+	CompactMeshHandle compact_model(const std::string& path);
+	TextureHandle texture(const std::string& path);
+	// block compressed copy of the texture, cached separately from the uncompressed one. normal_map
+	// encodes a tangent space normal map as BC5 instead of BC1, x and y kept apart and z rebuilt
+	CompressedTextureHandle compressed_texture(const std::string& path, bool normal_map=false);
+
+	// the same loads started on pool, they return straight away with a future for the handle. a file
+	// that's already loaded or loading is shared just the same. the cache has to outlive the pool's tasks
+	std::shared_future<ModelHandle> model_async(const std::string& path, ThreadPool& pool);
+	std::shared_future<TextureHandle> texture_async(const std::string& path, ThreadPool& pool);
+	std::shared_future<CompressedTextureHandle> compressed_texture_async(const std::string& path, ThreadPool& pool, bool normal_map=false);
+
+	void set_budget(size_t budget_bytes);
+	Stats stats();
+
+	// type erased asset and the function that loads one and reports its size
+	typedef std::shared_ptr<const void> Asset;
+	typedef std::function<Asset(const std::string&, size_t&)> Loader;
+
+private:
+	struct Entry {
+		std::shared_future<Asset> asset;
+		long mtime_sec, mtime_nsec;
+		size_t bytes;
+		bool loading;
+		std::list<std::string>::iterator lru; // position in lru_, front is most recent
+	};
+
+	std::mutex mutex_;
+	std::map<std::string, Entry> entries_;
+	std::list<std::string> lru_;
+	size_t budget_;
+	Stats stats_;
+
+	Asset get(const std::string& kind, const std::string& path, Loader load);
+	void evict();
+};
+
+#endif // TATE_ASSETS_H
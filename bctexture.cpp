@@ -0,0 +1,246 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <iostream>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "tgaimage.h"
+#include "trace.h"
+#include "bctexture.h"
+
+static std::atomic<unsigned long> next_texture_id(1);
+
+// texels are packed like TGAColor::val, b in the low byte
+static inline unsigned int pack(int b, int g, int r, int a) {
+	return (unsigned int)b | (unsigned int)g<<8 | (unsigned int)r<<16 | (unsigned int)a<<24;
+}
+
+static inline unsigned short to565(float r, float g, float b) {
+	int r5 = (int)std::lround(std::min(std::max(r, 0.f), 255.f)*31/255.f);
+	int g6 = (int)std::lround(std::min(std::max(g, 0.f), 255.f)*63/255.f);
+	int b5 = (int)std::lround(std::min(std::max(b, 0.f), 255.f)*31/255.f);
+	return (unsigned short)(r5<<11 | g6<<5 | b5);
+}
+
+static inline void from565(unsigned short c, int rgb[3]) {
+	int r5 = c>>11, g6 = (c>>5)&63, b5 = c&31;
+	rgb[0] = (r5<<3) | (r5>>2);
+	rgb[1] = (g6<<2) | (g6>>4);
+	rgb[2] = (b5<<3) | (b5>>2);
+}
+
+// bc1 color block from 16 rgb texels. endpoints are the extremes along the principal axis of the colors
+static void encode_bc1(const float rgb[16][3], unsigned char *out) {
+	float mean[3] = {0, 0, 0};
+	for (int i=0; i<16; i++) for (int c=0; c<3; c++) mean[c] += rgb[i][c]/16;
+	float cov[6] = {0, 0, 0, 0, 0, 0};
+	for (int i=0; i<16; i++) {
+		float d[3] = {rgb[i][0]-mean[0], rgb[i][1]-mean[1], rgb[i][2]-mean[2]};
+		cov[0] += d[0]*d[0]; cov[1] += d[0]*d[1]; cov[2] += d[0]*d[2];
+		cov[3] += d[1]*d[1]; cov[4] += d[1]*d[2]; cov[5] += d[2]*d[2];
+	}
+	// a few rounds of power iteration is plenty for a 3x3
+	float axis[3] = {1, 1, 1};
+	for (int it=0; it<4; it++) {
+		float x = cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2];
+		float y = cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2];
+		float z = cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2];
+		float n = std::sqrt(x*x + y*y + z*z);
+		if (n<1e-6f) break;
+		axis[0] = x/n; axis[1] = y/n; axis[2] = z/n;
+	}
+	float tmin = 1e30f, tmax = -1e30f;
+	for (int i=0; i<16; i++) {
+		float t = (rgb[i][0]-mean[0])*axis[0] + (rgb[i][1]-mean[1])*axis[1] + (rgb[i][2]-mean[2])*axis[2];
+		tmin = std::min(tmin, t);
+		tmax = std::max(tmax, t);
+	}
+	unsigned short c0 = to565(mean[0]+tmax*axis[0], mean[1]+tmax*axis[1], mean[2]+tmax*axis[2]);
+	unsigned short c1 = to565(mean[0]+tmin*axis[0], mean[1]+tmin*axis[1], mean[2]+tmin*axis[2]);
+	if (c0<c1) std::swap(c0, c1);
+
+	unsigned int indices = 0;
+	if (c0!=c1) {
+		// c0>c1 selects the four color mode
+		int p[4][3];
+		from565(c0, p[0]);
+		from565(c1, p[1]);
+		for (int c=0; c<3; c++) {
+			p[2][c] = (2*p[0][c] + p[1][c])/3;
+			p[3][c] = (p[0][c] + 2*p[1][c])/3;
+		}
+		for (int i=0; i<16; i++) {
+			int best = 0;
+			float best_d = 1e30f;
+			for (int k=0; k<4; k++) {
+				float dr = rgb[i][0]-p[k][0], dg = rgb[i][1]-p[k][1], db = rgb[i][2]-p[k][2];
+				float d = dr*dr + dg*dg + db*db;
+				if (d<best_d) { best_d = d; best = k; }
+			}
+			indices |= (unsigned int)best << (2*i);
+		}
+	}
+	out[0] = c0&0xff; out[1] = c0>>8;
+	out[2] = c1&0xff; out[3] = c1>>8;
+	for (int k=0; k<4; k++) out[4+k] = (indices >> (8*k)) & 0xff;
+}
+
+static void decode_bc1(const unsigned char *in, int rgb[16][3]) {
+	unsigned short c0 = in[0] | in[1]<<8;
+	unsigned short c1 = in[2] | in[3]<<8;
+	unsigned int indices = in[4] | in[5]<<8 | in[6]<<16 | (unsigned int)in[7]<<24;
+	int p[4][3];
+	from565(c0, p[0]);
+	from565(c1, p[1]);
+	for (int c=0; c<3; c++) {
+		if (c0>c1) {
+			p[2][c] = (2*p[0][c] + p[1][c])/3;
+			p[3][c] = (p[0][c] + 2*p[1][c])/3;
+		} else {
+			p[2][c] = (p[0][c] + p[1][c])/2;
+			p[3][c] = 0;
+		}
+	}
+	for (int i=0; i<16; i++) {
+		int k = (indices >> (2*i)) & 3;
+		rgb[i][0] = p[k][0]; rgb[i][1] = p[k][1]; rgb[i][2] = p[k][2];
+	}
+}
+
+// bc4 single channel block. a0>a1 selects the 8 value ramp between them
+static void encode_bc4(const unsigned char v[16], unsigned char *out) {
+	int lo = 255, hi = 0;
+	for (int i=0; i<16; i++) { lo = std::min(lo, (int)v[i]); hi = std::max(hi, (int)v[i]); }
+	out[0] = hi;
+	out[1] = lo;
+	unsigned long long indices = 0;
+	if (hi>lo) {
+		int p[8];
+		p[0] = hi; p[1] = lo;
+		for (int k=2; k<8; k++) p[k] = ((8-k)*hi + (k-1)*lo)/7;
+		for (int i=0; i<16; i++) {
+			int best = 0, best_d = 256;
+			for (int k=0; k<8; k++) {
+				int d = std::abs(v[i]-p[k]);
+				if (d<best_d) { best_d = d; best = k; }
+			}
+			indices |= (unsigned long long)best << (3*i);
+		}
+	}
+	for (int k=0; k<6; k++) out[2+k] = (indices >> (8*k)) & 0xff;
+}
+
+static void decode_bc4(const unsigned char *in, int v[16]) {
+	int a0 = in[0], a1 = in[1];
+	int p[8];
+	p[0] = a0; p[1] = a1;
+	if (a0>a1) {
+		for (int k=2; k<8; k++) p[k] = ((8-k)*a0 + (k-1)*a1)/7;
+	} else {
+		for (int k=2; k<6; k++) p[k] = ((6-k)*a0 + (k-1)*a1)/5;
+		p[6] = 0;
+		p[7] = 255;
+	}
+	unsigned long long indices = 0;
+	for (int k=0; k<6; k++) indices |= (unsigned long long)in[2+k] << (8*k);
+	for (int i=0; i<16; i++) v[i] = p[(indices >> (3*i)) & 7];
+}
+
+// grayscale goes to BC4, rgba to BC3, rgb to BC1
+BCTexture::BCTexture(const TGAImage& img) : BCTexture(img, img.get_bytespp()==TGAImage::GRAYSCALE ? BC4 : img.get_bytespp()==TGAImage::RGBA ? BC3 : BC1) {
+}
+
+BCTexture::BCTexture(const TGAImage& img, Format format) : blocks(), width(img.get_width()), height(img.get_height()),
+	bytespp(img.get_bytespp()), format(format), block_bytes(format==BC1 || format==BC4 ? 8 : 16),
+	blocks_wide((img.get_width()+3)/4), id(next_texture_id++) {
+	TRACE_SCOPE("compress texture");
+	if (format==BC3) bytespp = TGAImage::RGBA;
+	if (format==BC5 || (format==BC1 && bytespp==TGAImage::GRAYSCALE)) bytespp = TGAImage::RGB;
+	encode(img);
+}
+
+void BCTexture::encode(const TGAImage& img) {
+	int blocks_high = (height+3)/4;
+	blocks.resize((size_t)blocks_wide*blocks_high*block_bytes);
+	int bpp = img.get_bytespp();
+	const unsigned char *data = img.buffer();
+	if (!data) return;
+	for (int by=0; by<blocks_high; by++) {
+		for (int bx=0; bx<blocks_wide; bx++) {
+			float rgb[16][3];
+			unsigned char ch[4][16];
+			for (int i=0; i<16; i++) {
+				// edge blocks repeat the last row/column
+				int x = std::min(bx*4 + (i&3), width-1);
+				int y = std::min(by*4 + (i>>2), height-1);
+				const unsigned char *p = data + ((size_t)x + (size_t)y*width)*bpp;
+				int b = p[0], g = bpp==1 ? p[0] : p[1], r = bpp==1 ? p[0] : p[2], a = bpp==4 ? p[3] : 255;
+				rgb[i][0] = r; rgb[i][1] = g; rgb[i][2] = b;
+				ch[0][i] = r; ch[1][i] = g; ch[2][i] = b; ch[3][i] = a;
+			}
+			unsigned char *out = &blocks[((size_t)bx + (size_t)by*blocks_wide)*block_bytes];
+			switch (format) {
+			case BC1: encode_bc1(rgb, out); break;
+			case BC3: encode_bc4(ch[3], out); encode_bc1(rgb, out+8); break;
+			case BC4: encode_bc4(ch[2], out); break;
+			case BC5: encode_bc4(ch[0], out); encode_bc4(ch[1], out+8); break;
+			}
+		}
+	}
+}
+
+void BCTexture::decode_block(int bx, int by, unsigned int texels[16]) const {
+	const unsigned char *in = &blocks[((size_t)bx + (size_t)by*blocks_wide)*block_bytes];
+	int rgb[16][3];
+	int v[16], w[16];
+	switch (format) {
+	case BC1:
+		decode_bc1(in, rgb);
+		for (int i=0; i<16; i++) texels[i] = pack(rgb[i][2], rgb[i][1], rgb[i][0], 255);
+		break;
+	case BC3:
+		decode_bc4(in, v);
+		decode_bc1(in+8, rgb);
+		for (int i=0; i<16; i++) texels[i] = pack(rgb[i][2], rgb[i][1], rgb[i][0], v[i]);
+		break;
+	case BC4:
+		decode_bc4(in, v);
+		for (int i=0; i<16; i++) texels[i] = pack(v[i], v[i], v[i], 255);
+		break;
+	case BC5:
+		decode_bc4(in, v);
+		decode_bc4(in+8, w);
+		for (int i=0; i<16; i++) {
+			float nx = v[i]/127.5f-1, ny = w[i]/127.5f-1;
+			float nz = std::sqrt(std::max(0.f, 1-nx*nx-ny*ny));
+			texels[i] = pack((int)((nz+1)*127.5f+.5f), w[i], v[i], 255);
+		}
+		break;
+	}
+}
+
+// small direct mapped cache of decoded blocks, one per thread so sampling needs no locking
+struct DecodedBlock {
+	unsigned long texture;
+	int block;
+	unsigned int texels[16];
+};
+static thread_local DecodedBlock block_cache[BC_CACHE_BLOCKS];
+
+TGAColor BCTexture::get(int x, int y) const {
+	if (blocks.empty() || x<0 || y<0 || x>=width || y>=height) {
+		return TGAColor();
+	}
+	int bx = x>>2, by = y>>2;
+	int block = bx + by*blocks_wide;
+	// neighbouring blocks in both directions land in different slots
+	DecodedBlock& c = block_cache[(((bx&7) | ((by&7)<<3)) ^ (id*5)) & (BC_CACHE_BLOCKS-1)];
+	if (c.texture!=id || c.block!=block) {
+		decode_block(bx, by, c.texels);
+		c.texture = id;
+		c.block = block;
+	}
+	return TGAColor(c.texels[(x&3) + (y&3)*4], bytespp);
+}
@@ -0,0 +1,41 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_BCTEXTURE_H
+#define TATE_BCTEXTURE_H
+
+#include <vector>
+#include "tgaimage.h"
+
+const int BC_CACHE_BLOCKS = 64; // decoded 4x4 blocks each thread keeps around, must be a power of two
+
+// texture held as 4x4 compressed blocks and decoded on the fly when sampled:
+//   BC1  rgb, 8 bytes a block (6:1 from 24 bit)
+//   BC3  rgb + separate alpha, 16 bytes a block (4:1 from 32 bit)
+//   BC4  one channel, 8 bytes a block (2:1 from grayscale)
+//   BC5  two channels, 16 bytes a block. for tangent space normal maps, z is rebuilt from x and y
+// get() has the same meaning as TGAImage::get() so it can stand in for it in the rasterizer
+class BCTexture {
+public:
+	enum Format { BC1, BC3, BC4, BC5 };
+	BCTexture(const TGAImage& img, Format format);
+	explicit BCTexture(const TGAImage& img);
+	TGAColor get(int x, int y) const;
+	int get_width() const { return width; }
+	int get_height() const { return height; }
+	int get_bytespp() const { return bytespp; }
+	Format get_format() const { return format; }
+	size_t bytes() const { return sizeof(BCTexture) + blocks.size(); }
+private:
+	std::vector<unsigned char> blocks;
+	int width, height;
+	int bytespp;      // of the decoded texels
+	Format format;
+	int block_bytes;
+	int blocks_wide;
+	unsigned long id; // tells this texture's blocks apart in the per thread cache
+	void encode(const TGAImage& img);
+	void decode_block(int bx, int by, unsigned int texels[16]) const;
+};
+
+#endif // TATE_BCTEXTURE_H
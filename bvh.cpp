@@ -0,0 +1,137 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include "geometry.h"
+#include "model.h"
+#include "trace.h"
+#include "bvh.h"
+
+// splits meshlets[first, first+n) in half along the longest axis of their centers and recurses
+static int build_node(std::vector<Meshlet>& meshlets, int first, int n, std::vector<BVHNode>& nodes) {
+	BVHNode node;
+	node.bmin = meshlets[first].bmin;
+	node.bmax = meshlets[first].bmax;
+	Vec3f cmin = meshlets[first].center;
+	Vec3f cmax = meshlets[first].center;
+	for (int i=first; i<first+n; i++) {
+		for (int a=0; a<3; a++) {
+			node.bmin.raw[a] = std::min(node.bmin.raw[a], meshlets[i].bmin.raw[a]);
+			node.bmax.raw[a] = std::max(node.bmax.raw[a], meshlets[i].bmax.raw[a]);
+			cmin.raw[a] = std::min(cmin.raw[a], meshlets[i].center.raw[a]);
+			cmax.raw[a] = std::max(cmax.raw[a], meshlets[i].center.raw[a]);
+		}
+	}
+	node.left = node.right = -1;
+	node.first_meshlet = first;
+	node.nmeshlets = n;
+	int idx = (int)nodes.size();
+	nodes.push_back(node);
+	if (n<=BVH_LEAF_MESHLETS) return idx;
+
+	int axis = 0;
+	Vec3f extent = cmax-cmin;
+	if (extent.y>extent.raw[axis]) axis = 1;
+	if (extent.z>extent.raw[axis]) axis = 2;
+	int half = n/2;
+	std::nth_element(meshlets.begin()+first, meshlets.begin()+first+half, meshlets.begin()+first+n,
+		[axis](const Meshlet& a, const Meshlet& b) { return a.center.raw[axis] < b.center.raw[axis]; });
+	int left = build_node(meshlets, first, half, nodes);
+	int right = build_node(meshlets, first+half, n-half, nodes);
+	nodes[idx].left = left;
+	nodes[idx].right = right;
+	return idx;
+}
+
+// builds the hierarchy over the model's meshlets. reorders the meshlets so every node covers a contiguous range
+void build_bvh(Model* model) {
+	TRACE_SCOPE("build bvh");
+	int n = model->nmeshlets();
+	if (n==0) return;
+	std::vector<Meshlet> meshlets(n);
+	for (int i=0; i<n; i++) meshlets[i] = model->meshlet(i);
+	std::vector<BVHNode> nodes;
+	build_node(meshlets, 0, n, nodes);
+	model->set_meshlets(meshlets);
+	model->set_bvh(nodes);
+	std::cerr << "# bvh nodes " << nodes.size() << std::endl;
+}
+
+// slab test. true if the ray enters the box before tmax
+bool ray_box(Vec3f orig, Vec3f inv_dir, Vec3f bmin, Vec3f bmax, float tmax) {
+	float tmin = 0;
+	for (int a=0; a<3; a++) {
+		float t0 = (bmin.raw[a]-orig.raw[a])*inv_dir.raw[a];
+		float t1 = (bmax.raw[a]-orig.raw[a])*inv_dir.raw[a];
+		if (t0>t1) std::swap(t0, t1);
+		tmin = std::max(tmin, t0);
+		tmax = std::min(tmax, t1);
+		if (tmin>tmax) return false;
+	}
+	return true;
+}
+
+// moller-trumbore ray/triangle intersection, keeps the hit if it's closer than the one in hit
+static bool ray_face(const Model* model, int i, Vec3f orig, Vec3f dir, RayHit& hit) {
+	const std::vector<Vec3i>& f = model->face(i);
+	Vec3f p0 = model->vert(f[0].ivert);
+	Vec3f e1 = model->vert(f[1].ivert)-p0;
+	Vec3f e2 = model->vert(f[2].ivert)-p0;
+	Vec3f pv = dir^e2;
+	float det = e1*pv;
+	if (std::abs(det)<1e-12) return false;
+	float inv_det = 1.f/det;
+	Vec3f tv = orig-p0;
+	float u = (tv*pv)*inv_det;
+	if (u<0 || u>1) return false;
+	Vec3f qv = tv^e1;
+	float v = (dir*qv)*inv_det;
+	if (v<0 || u+v>1) return false;
+	float t = (e2*qv)*inv_det;
+	if (t<=0 || t>=hit.t) return false;
+	hit.t = t;
+	hit.face = i;
+	hit.bary = Vec3f(1-u-v, u, v);
+	return true;
+}
+
+// closest hit of the ray orig+t*dir with the model. uses the bvh when there is one
+bool raycast(const Model* model, Vec3f orig, Vec3f dir, RayHit& hit) {
+	hit.t = std::numeric_limits<float>::max();
+	hit.face = -1;
+	if (model->nbvh_nodes()==0) {
+		for (int i=0; i<model->nfaces(); i++) ray_face(model, i, orig, dir, hit);
+		return hit.face>=0;
+	}
+	Vec3f inv_dir;
+	for (int a=0; a<3; a++) inv_dir.raw[a] = 1.f/dir.raw[a];
+	std::vector<int> stack(1, 0);
+	while (!stack.empty()) {
+		BVHNode node = model->bvh_node(stack.back());
+		stack.pop_back();
+		if (!ray_box(orig, inv_dir, node.bmin, node.bmax, hit.t)) continue;
+		if (node.left>=0) {
+			stack.push_back(node.right);
+			stack.push_back(node.left);
+			continue;
+		}
+		for (int k=node.first_meshlet; k<node.first_meshlet+node.nmeshlets; k++) {
+			Meshlet m = model->meshlet(k);
+			if (!ray_box(orig, inv_dir, m.bmin, m.bmax, hit.t)) continue;
+			for (int i=m.first_face; i<m.first_face+m.nfaces; i++) ray_face(model, i, orig, dir, hit);
+		}
+	}
+	return hit.face>=0;
+}
+
+// the face under pixel x,y of a width*width render from camera_pos, same projection as rasterize()
+bool pick(const Model* model, int x, int y, int width, Vec3f camera_pos, RayHit& hit) {
+	float scale = width/2;
+	Vec3f orig = Vec3f(0, 0, camera_pos.z);
+	Vec3f on_screen = Vec3f((x+.5f)/scale-1, (y+.5f)/scale-1, 0);
+	return raycast(model, orig, on_screen-orig, hit);
+}
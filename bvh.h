@@ -0,0 +1,23 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_BVH_H
+#define TATE_BVH_H
+
+#include "geometry.h"
+#include "model.h"
+
+const int BVH_LEAF_MESHLETS = 2; // leaves hold at most this many meshlets
+
+struct RayHit {
+	float t;     // distance along the ray, in units of dir
+	int face;
+	Vec3f bary;  // barycentric coordinates of the hit inside the face
+};
+
+void build_bvh(Model* model);
+bool ray_box(Vec3f orig, Vec3f inv_dir, Vec3f bmin, Vec3f bmax, float tmax);
+bool raycast(const Model* model, Vec3f orig, Vec3f dir, RayHit& hit);
+bool pick(const Model* model, int x, int y, int width, Vec3f camera_pos, RayHit& hit);
+
+#endif // TATE_BVH_H
@@ -0,0 +1,126 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <map>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "compactmesh.h"
+
+const float UNORM16_MAX = 65535.f;
+
+static uint16_t to_unorm16(float v, float base, float step) {
+	float q = step>0 ? (v-base)/step : 0;
+	return (uint16_t)std::min(UNORM16_MAX, std::max(0.f, std::round(q)));
+}
+
+static int16_t to_snorm16(float v) {
+	return (int16_t)std::round(std::min(1.f, std::max(-1.f, v))*SNORM16_MAX);
+}
+
+// unit vector onto the octahedron |x|+|y|+|z|=1, with the lower half folded out over the corners
+static void encode_octahedral(Vec3f n, int16_t& u, int16_t& v) {
+	float s = std::abs(n.x)+std::abs(n.y)+std::abs(n.z);
+	if (s<=0) {
+		u = v = 0;
+		return;
+	}
+	float x = n.x/s, y = n.y/s;
+	if (n.z<0) {
+		float fx = (1-std::abs(y))*(x>=0 ? 1 : -1);
+		float fy = (1-std::abs(x))*(y>=0 ? 1 : -1);
+		x = fx;
+		y = fy;
+	}
+	u = to_snorm16(x);
+	v = to_snorm16(y);
+}
+
+CompactMesh::CompactMesh(const Model& model) : nfaces_(model.nfaces()) {
+	min = model.min;
+	max = model.max;
+	pos_base = model.min;
+	for (int c=0; c<3; c++) pos_step.raw[c] = std::max(0.f, model.max.raw[c]-model.min.raw[c])/UNORM16_MAX;
+	Vec2f uv_max;
+	for (int c=0; c<2; c++) {
+		uv_base.raw[c] = std::numeric_limits<float>::max();
+		uv_max.raw[c] = std::numeric_limits<float>::lowest();
+	}
+	for (int i=0; i<model.ntexture_verts(); i++) {
+		Vec2f t = model.texture_vert(i);
+		for (int c=0; c<2; c++) {
+			uv_base.raw[c] = std::min(uv_base.raw[c], t.raw[c]);
+			uv_max.raw[c] = std::max(uv_max.raw[c], t.raw[c]);
+		}
+	}
+	if (model.ntexture_verts()==0) uv_base = uv_max = Vec2f();
+	for (int c=0; c<2; c++) uv_step.raw[c] = (uv_max.raw[c]-uv_base.raw[c])/UNORM16_MAX;
+
+	// one vertex per distinct corner. the corners keep the loader's uv pairing, the same one render() uses
+	std::map<std::pair<int, std::pair<int,int>>, uint32_t> ids;
+	std::vector<uint32_t> index(nfaces_*3, 0);
+	fu.assign(nfaces_, NO_FACE_NORMAL);
+	fv.assign(nfaces_, 0);
+	for (int i=0; i<nfaces_; i++) {
+		std::vector<Vec3i> f = model.face(i);
+		if (f.size()<3) continue; // left as 0,0,0, which has no area and never draws
+		Vec3f fn = (model.vert(f[1].ivert)-model.vert(f[0].ivert))^(model.vert(f[2].ivert)-model.vert(f[0].ivert));
+		if (fn.norm()>0) encode_octahedral(fn, fu[i], fv[i]);
+		for (int j=0; j<3; j++) {
+			std::pair<std::map<std::pair<int, std::pair<int,int>>, uint32_t>::iterator, bool> it = ids.insert(std::make_pair(std::make_pair(f[j].ivert, std::make_pair(f[j].iuv, f[j].inorm)), (uint32_t)px.size()));
+			index[i*3+j] = it.first->second;
+			if (!it.second) continue;
+			Vec3f p = model.vert(f[j].ivert);
+			px.push_back(to_unorm16(p.x, pos_base.x, pos_step.x));
+			py.push_back(to_unorm16(p.y, pos_base.y, pos_step.y));
+			pz.push_back(to_unorm16(p.z, pos_base.z, pos_step.z));
+			bool has_uv = f[j].iuv>=0 && f[j].iuv<model.ntexture_verts();
+			Vec2f t = has_uv ? model.texture_vert(f[j].iuv) : uv_base;
+			tu.push_back(to_unorm16(t.u, uv_base.u, uv_step.u));
+			tv.push_back(to_unorm16(t.v, uv_base.v, uv_step.v));
+			bool has_normal = f[j].inorm>=0 && f[j].inorm<model.nnormal_verts();
+			int16_t u, v;
+			encode_octahedral(has_normal ? model.normal_vert(f[j].inorm) : fn, u, v);
+			nu.push_back(u);
+			nv.push_back(v);
+		}
+	}
+	if (px.size()<=65536) index16.assign(index.begin(), index.end());
+	else index32.swap(index);
+	std::vector<uint16_t>* q[5] = {&px, &py, &pz, &tu, &tv};
+	for (int k=0; k<5; k++) q[k]->shrink_to_fit();
+	nu.shrink_to_fit();
+	nv.shrink_to_fit();
+}
+
+Vec3f CompactMesh::vert(int i) const {
+	return Vec3f(pos_base.x+px[i]*pos_step.x, pos_base.y+py[i]*pos_step.y, pos_base.z+pz[i]*pos_step.z);
+}
+
+Vec2f CompactMesh::texture_vert(int i) const {
+	return Vec2f(uv_base.u+tu[i]*uv_step.u, uv_base.v+tv[i]*uv_step.v);
+}
+
+static Vec3f decode_octahedral(int16_t u, int16_t v) {
+	float x = u/SNORM16_MAX, y = v/SNORM16_MAX;
+	float z = 1-std::abs(x)-std::abs(y);
+	// unfold the lower half
+	float t = std::max(-z, 0.f);
+	x += x>=0 ? -t : t;
+	y += y>=0 ? -t : t;
+	Vec3f n(x, y, z);
+	return n.normalize();
+}
+
+Vec3f CompactMesh::normal(int i) const {
+	return decode_octahedral(nu[i], nv[i]);
+}
+
+Vec3f CompactMesh::face_normal(int face) const {
+	return fu[face]==NO_FACE_NORMAL ? Vec3f() : decode_octahedral(fu[face], fv[face]);
+}
+
+size_t CompactMesh::bytes() const {
+	return sizeof(CompactMesh) + (px.capacity()+py.capacity()+pz.capacity()+tu.capacity()+tv.capacity()+index16.capacity())*sizeof(uint16_t)
+		+ (nu.capacity()+nv.capacity()+fu.capacity()+fv.capacity())*sizeof(int16_t) + index32.capacity()*sizeof(uint32_t);
+}
@@ -0,0 +1,53 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_COMPACTMESH_H
+#define TATE_COMPACTMESH_H
+
+#include <vector>
+#include <cstdint>
+#include "geometry.h"
+#include "model.h"
+
+const float SNORM16_MAX = 32767.f;
+const int16_t NO_FACE_NORMAL = -32768; // in fu, a face without area. the encoding never gives it
+// a model packed small enough to keep lots of them resident. every distinct (vert, uv, normal) corner of the
+// model becomes one vertex, numbered in the order the faces first use them, and each attribute is quantized
+// into its own array:
+//   position  3 x unorm16 over the model's bounding box (6 bytes, was 12)
+//   uv        2 x unorm16 over the range the uvs span (4 bytes, was 8)
+//   normal    2 x snorm16 octahedral (4 bytes, was 12)
+// a face is 3 indices, 16 bit when there are at most 65536 vertices (6 bytes, was a vector of 3 Vec3i),
+// and its unit normal, octahedral like the vertex normals, so render() can light and cull faces without
+// touching their vertices. faces keep the model's order so its meshlet sorting carries over. render()
+// decodes the arrays as it goes
+class CompactMesh {
+public:
+	explicit CompactMesh(const Model& model);
+	int nverts() const { return (int)px.size(); }
+	int nfaces() const { return nfaces_; }
+	bool wide_indices() const { return !index32.empty(); }
+	size_t bytes() const;
+	// decoded attributes, for checking the encoding
+	Vec3f vert(int i) const;
+	Vec2f texture_vert(int i) const;
+	Vec3f normal(int i) const;
+	Vec3f face_normal(int face) const; // zero for a face without area
+	int index(int face, int j) const { return wide_indices() ? (int)index32[face*3+j] : (int)index16[face*3+j]; }
+
+	// the quantized arrays. position = pos_base + q*pos_step per axis, likewise uv
+	std::vector<uint16_t> px, py, pz;
+	std::vector<uint16_t> tu, tv;
+	std::vector<int16_t> nu, nv;
+	std::vector<int16_t> fu, fv; // per face
+	std::vector<uint16_t> index16;
+	std::vector<uint32_t> index32;
+	Vec3f pos_base, pos_step;
+	Vec2f uv_base, uv_step;
+	Vec3f min;
+	Vec3f max;
+private:
+	int nfaces_;
+};
+
+#endif // TATE_COMPACTMESH_H
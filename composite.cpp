@@ -0,0 +1,121 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include "tgaimage.h"
+#include "imageview.h"
+#include "model.h"
+#include "renderer.h"
+#include "bctexture.h"
+#include "threadpool.h"
+#include "trace.h"
+#include "composite.h"
+
+// depth half of one row of the merge: keeps the nearer depth and notes which pixels src won. straight
+// selects with no branches, so it vectorizes
+static void composite_depth(int *__restrict dst_z, const int *__restrict src_z, unsigned char *__restrict near, int n) {
+	for (int x=0; x<n; x++) {
+		near[x] = src_z[x]>dst_z[x];
+		dst_z[x] = near[x] ? src_z[x] : dst_z[x];
+	}
+}
+
+// color half: the pixels src won come in runs, a part is mostly one piece, so they're copied a run at a
+// time. a per channel select doesn't vectorize for 3 byte pixels and this does as well for every size
+static void composite_color(unsigned char* dst, const unsigned char* src, const unsigned char* near, int n, int bpp) {
+	int x = 0;
+	while (x<n) {
+		while (x<n && !near[x]) x++;
+		int start = x;
+		while (x<n && near[x]) x++;
+		if (x>start) memcpy(dst+start*bpp, src+start*bpp, (size_t)(x-start)*bpp);
+	}
+}
+
+// rows row0..row1-1 of dst. src covers the rows from y0 and the columns from x0
+static void composite_rows(const ImageView& dst, int* dst_z, const ConstImageView& src, const int* src_z, int x0, int y0, int row0, int row1) {
+	int w = dst.get_width(), sw = src.get_width();
+	int xa = std::max(0, x0), xb = std::min(w, x0+sw);
+	row0 = std::max(row0, y0);
+	row1 = std::min(row1, y0+src.get_height());
+	int bpp = dst.get_bytespp();
+	if (xa>=xb || src.get_bytespp()!=bpp) return;
+	std::vector<unsigned char> near(xb-xa);
+	for (int y=row0; y<row1; y++) {
+		unsigned char* d = dst.pixel(xa, y);
+		int* dz = dst_z+(size_t)y*w+xa;
+		const unsigned char* s = src.pixel(xa-x0, y-y0);
+		const int* sz = src_z+(size_t)(y-y0)*sw+(xa-x0);
+		composite_depth(dz, sz, near.data(), xb-xa);
+		composite_color(d, s, near.data(), xb-xa, bpp);
+	}
+}
+
+void depth_composite(const ImageView& dst, int* dst_z, const ConstImageView& src, const int* src_z, int x0, int y0) {
+	composite_rows(dst, dst_z, src, src_z, x0, y0, 0, dst.get_height());
+}
+
+static void add_stats(RenderStats& to, const RenderStats& s) {
+	to.faces += s.faces;
+	to.fragments += s.fragments;
+	to.fragments_shaded += s.fragments_shaded;
+	to.texel_line_changes += s.texel_line_changes;
+	to.meshlets_drawn += s.meshlets_drawn;
+	to.meshlets_culled += s.meshlets_culled;
+}
+
+// a part's private buffers, covering rect of the image
+struct PartBuffer {
+	bool drawn;
+	ScreenRect rect;
+	TGAImage color;
+	std::vector<int> depth;
+	RenderStats stats;
+	PartBuffer() : drawn(false), rect(), color(), depth(), stats() {}
+};
+
+template <class Texture> void render_parts(int nparts, PartSource<Texture> source, const ImageView& image, int* zbuffer, Vec3f light_source, Vec3f camera_pos, ThreadPool* pool, RenderStats* stats) {
+	int w = image.get_width(), h = image.get_height();
+	std::vector<PartBuffer> buffers(nparts);
+	parallel_for(pool, nparts, 1, [&](int begin, int end) {
+		for (int i=begin; i<end; i++) {
+			PartBuffer& b = buffers[i];
+			RenderPart<Texture> part;
+			if (!source(i, part) || !part.model || !part.diffuse) continue;
+			if (i==0) {
+				render(part.model, *part.diffuse, image, zbuffer, part.xf, light_source, camera_pos, &b.stats);
+				continue;
+			}
+			if (!screen_rect(part.model, part.xf, w, h, camera_pos, b.rect)) continue;
+			int rw = b.rect.x1-b.rect.x0+1, rh = b.rect.y1-b.rect.y0+1;
+			b.color = TGAImage(rw, rh, image.get_bytespp());
+			b.depth.assign((size_t)rw*rh, std::numeric_limits<int>::min());
+			render_viewport(part.model, *part.diffuse, b.color, b.depth.data(), part.xf, light_source, camera_pos, Viewport(w/2, w/2, b.rect.x0, b.rect.y0), &b.stats);
+			b.drawn = true;
+		}
+	});
+	// every band takes the parts in order, so ties still go to the earlier part
+	parallel_for(pool, h, COMPOSITE_BAND, [&](int row0, int row1) {
+		TRACE_SCOPE("composite");
+		for (int i=1; i<nparts; i++) {
+			const PartBuffer& b = buffers[i];
+			if (b.drawn) composite_rows(image, zbuffer, b.color, b.depth.data(), b.rect.x0, b.rect.y0, row0, row1);
+		}
+	});
+	if (stats) {
+		for (int i=0; i<nparts; i++) add_stats(*stats, buffers[i].stats);
+	}
+}
+
+template <class Texture> void render_parts(const std::vector<RenderPart<Texture>>& parts, const ImageView& image, int* zbuffer, Vec3f light_source, Vec3f camera_pos, ThreadPool* pool, RenderStats* stats) {
+	render_parts<Texture>((int)parts.size(), [&parts](int i, RenderPart<Texture>& part) { part = parts[i]; return true; }, image, zbuffer, light_source, camera_pos, pool, stats);
+}
+
+#define INSTANTIATE_PARTS(Texture) \
+	template void render_parts<Texture>(int, PartSource<Texture>, const ImageView&, int*, Vec3f, Vec3f, ThreadPool*, RenderStats*); \
+	template void render_parts<Texture>(const std::vector<RenderPart<Texture>>&, const ImageView&, int*, Vec3f, Vec3f, ThreadPool*, RenderStats*);
+INSTANTIATE_PARTS(TGAImage)
+INSTANTIATE_PARTS(BCTexture)
@@ -0,0 +1,42 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_COMPOSITE_H
+#define TATE_COMPOSITE_H
+
+#include <vector>
+#include <functional>
+#include "tgaimage.h"
+#include "imageview.h"
+#include "geometry.h"
+#include "model.h"
+#include "renderer.h"
+
+class ThreadPool;
+
+const int COMPOSITE_BAND = 32; // rows per composite task
+
+// one object of a scene for render_parts()
+template <class Texture> struct RenderPart {
+	const Model* model;
+	const Texture* diffuse;
+	Instance xf;
+	RenderPart(const Model* model=NULL, const Texture* diffuse=NULL, Instance xf=Instance()) : model(model), diffuse(diffuse), xf(xf) {}
+};
+
+// fills in part i, called on the thread that's about to draw it so loading it overlaps with drawing the
+// others. false leaves the part out
+template <class Texture> using PartSource = std::function<bool(int, RenderPart<Texture>&)>;
+
+// sort-last rendering: every part is drawn on its own task, the first straight into image and zbuffer
+// and the rest into private color and depth buffers the size of their screen rect. those are then merged
+// over image in part order by a per pixel depth compare, with the rows spread over pool. nearer wins and
+// an earlier part wins a tie, so the result is the same as render() on each part in turn
+template <class Texture> void render_parts(int nparts, PartSource<Texture> source, const ImageView& image, int* zbuffer, Vec3f light_source, Vec3f camera_pos, ThreadPool* pool=NULL, RenderStats* stats=NULL);
+template <class Texture> void render_parts(const std::vector<RenderPart<Texture>>& parts, const ImageView& image, int* zbuffer, Vec3f light_source, Vec3f camera_pos, ThreadPool* pool=NULL, RenderStats* stats=NULL);
+
+// copies the pixels of src that are nearer than dst's, and their depth, into dst. src's w x h lands with
+// its first pixel at x0, y0 of dst, both depth buffers are packed rows of their own width
+void depth_composite(const ImageView& dst, int* dst_z, const ConstImageView& src, const int* src_z, int x0, int y0);
+
+#endif // TATE_COMPOSITE_H
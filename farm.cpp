@@ -0,0 +1,299 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "tgaimage.h"
+#include "imageview.h"
+#include "model.h"
+#include "renderer.h"
+#include "assets.h"
+#include "threadpool.h"
+#include "server.h"
+#include "farm.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static bool send_all(int fd, const char *p, size_t n) {
+	while (n>0) {
+		ssize_t k = send(fd, p, n, MSG_NOSIGNAL);
+		if (k<0 && errno==EINTR) continue;
+		if (k<=0) return false;
+		p += k;
+		n -= k;
+	}
+	return true;
+}
+
+// next line from fd, buffered in pending. false at eof
+static bool read_line(int fd, std::string& pending, std::string& line) {
+	size_t nl;
+	char buf[4096];
+	while ((nl = pending.find('\n'))==std::string::npos) {
+		ssize_t n = read(fd, buf, sizeof(buf));
+		if (n<0 && errno==EINTR) continue;
+		if (n<=0) return false;
+		pending.append(buf, n);
+	}
+	line = pending.substr(0, nl);
+	pending.erase(0, nl+1);
+	return true;
+}
+
+// one window of the job's picture into a tile sized image, projected as the whole picture would be
+template <class Texture> static std::string render_tile(const RenderJob& job, const Model* model, std::shared_ptr<const Texture> texture, int x0, int y0, TGAImage& tile) {
+	if (!texture) return "can't load texture " + job.texture;
+	std::vector<int> zbuffer((size_t)tile.get_width()*tile.get_height(), std::numeric_limits<int>::min());
+	float scale = job.width/2;
+	render_viewport(model, *texture, tile, zbuffer.data(), Instance(), job.light, job.camera, Viewport(scale, scale, x0, y0));
+	return "";
+}
+
+// a worker's whole life: tile requests in, tiles out, until the coordinator hangs up
+static void worker_loop(int fd) {
+	AssetCache cache;
+	ThreadPool loaders(ASSET_LOADERS);
+	std::string pending, line;
+	while (read_line(fd, pending, line)) {
+		std::istringstream iss(line);
+		int x0, y0, w, h;
+		RenderJob job;
+		std::string rest, error;
+		if (!(iss >> x0 >> y0 >> w >> h) || w<=0 || h<=0) error = "bad tile request";
+		else {
+			std::getline(iss, rest);
+			if (parse_job(rest, job, error)) {
+				TGAImage tile;
+				// a throw fails the job like any other error instead of killing the worker, which would only
+				// get the tile retried
+				try {
+					// the texture loads on loaders while this thread loads the model
+					std::shared_future<TextureHandle> texture = job.compress ? std::shared_future<TextureHandle>() : cache.texture_async(job.texture, loaders);
+					std::shared_future<CompressedTextureHandle> compressed = job.compress ? cache.compressed_texture_async(job.texture, loaders) : std::shared_future<CompressedTextureHandle>();
+					ModelHandle model = cache.model(job.model);
+					tile = TGAImage(w, h, TGAImage::RGB);
+					if (!model) error = "can't load model " + job.model;
+					else if (job.compress) error = render_tile(job, model.get(), compressed.get(), x0, y0, tile);
+					else error = render_tile(job, model.get(), texture.get(), x0, y0, tile);
+				} catch (const std::exception& e) {
+					error = std::string("can't render: ") + e.what();
+				}
+				if (error.empty()) {
+					std::ostringstream head;
+					head << "tile " << x0 << " " << y0 << " " << w << " " << h << "\n";
+					std::string s = head.str();
+					if (!send_all(fd, s.data(), s.size()) || !send_all(fd, (const char *)tile.buffer(), (size_t)w*h*3)) return;
+					continue;
+				}
+			}
+		}
+		std::string s = "error " + error + "\n";
+		if (!send_all(fd, s.data(), s.size())) return;
+	}
+}
+
+struct FarmWorker {
+	pid_t pid;
+	int fd;
+	int tile;                    // index of the tile it's rendering, -1 when idle
+	Clock::time_point sent;
+	std::string in;              // reply bytes so far
+};
+
+struct FarmTile {
+	int x0, y0, w, h;
+	int tries;
+};
+
+// forks worker i. the child keeps only its own end of its own socket
+static bool spawn(std::vector<FarmWorker>& workers, int i) {
+	int sv[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv)!=0) return false;
+	std::cout.flush();
+	std::cerr.flush();
+	pid_t pid = fork();
+	if (pid<0) {
+		close(sv[0]);
+		close(sv[1]);
+		return false;
+	}
+	if (pid==0) {
+		close(sv[0]);
+		for (size_t k=0; k<workers.size(); k++) if (workers[k].fd>=0) close(workers[k].fd);
+		worker_loop(sv[1]);
+		_exit(0);
+	}
+	close(sv[1]);
+	workers[i].pid = pid;
+	workers[i].fd = sv[0];
+	workers[i].tile = -1;
+	workers[i].in.clear();
+	return true;
+}
+
+static void reap(FarmWorker& w, bool kill_it) {
+	if (w.fd>=0) close(w.fd);
+	if (kill_it) kill(w.pid, SIGKILL);
+	waitpid(w.pid, NULL, 0);
+	w.fd = -1;
+	w.tile = -1;
+}
+
+int render_farm(const std::string& job_line, int nworkers, int tile_size, double timeout_ms) {
+	RenderJob job;
+	std::string error;
+	if (!parse_job(job_line, job, error)) {
+		std::cerr << "can't parse job: " << error << std::endl;
+		return 1;
+	}
+	if (job.budget_ms>0) {
+		std::cerr << "can't render a budget job on the farm" << std::endl;
+		return 1;
+	}
+	if (nworkers<1) nworkers = 1;
+	if (tile_size<1) tile_size = FARM_TILE;
+	Clock::time_point start = Clock::now();
+
+	std::vector<FarmTile> tiles;
+	for (int y=0; y<job.height; y+=tile_size) {
+		for (int x=0; x<job.width; x+=tile_size) {
+			FarmTile t = {x, y, std::min(tile_size, job.width-x), std::min(tile_size, job.height-y), 0};
+			tiles.push_back(t);
+		}
+	}
+	std::deque<int> queue;
+	for (size_t i=0; i<tiles.size(); i++) queue.push_back(i);
+
+	std::vector<FarmWorker> workers(std::min(nworkers, (int)tiles.size()));
+	for (size_t i=0; i<workers.size(); i++) workers[i].fd = -1;
+	for (size_t i=0; i<workers.size(); i++) {
+		if (!spawn(workers, i)) {
+			std::cerr << "can't start worker: " << strerror(errno) << std::endl;
+			for (size_t k=0; k<i; k++) reap(workers[k], true);
+			return 1;
+		}
+	}
+
+	TGAImage image(job.width, job.height, TGAImage::RGB);
+	size_t done = 0;
+	int redispatched = 0;
+	// puts a lost tile back in the queue and gives its worker a fresh process
+	auto lost = [&](int i, bool kill_it, const char *why) {
+		FarmTile& t = tiles[workers[i].tile];
+		std::cerr << "# worker " << workers[i].pid << " " << why << " on tile " << t.x0 << "," << t.y0 << ", redispatching" << std::endl;
+		queue.push_front(workers[i].tile);
+		redispatched++;
+		reap(workers[i], kill_it);
+		if (!spawn(workers, i)) error = std::string("can't restart worker: ") + strerror(errno);
+	};
+
+	while (done<tiles.size() && error.empty()) {
+		// hand out work
+		for (size_t i=0; i<workers.size() && !queue.empty(); i++) {
+			FarmWorker& w = workers[i];
+			if (w.tile>=0) continue;
+			int k = queue.front();
+			FarmTile& t = tiles[k];
+			if (t.tries++==FARM_MAX_TRIES) {
+				error = "tile " + std::to_string(t.x0) + "," + std::to_string(t.y0) + " failed " + std::to_string(FARM_MAX_TRIES) + " times";
+				break;
+			}
+			queue.pop_front();
+			std::ostringstream req;
+			req << t.x0 << " " << t.y0 << " " << t.w << " " << t.h << " " << job_line << "\n";
+			std::string s = req.str();
+			w.tile = k;
+			w.sent = Clock::now();
+			if (!send_all(w.fd, s.data(), s.size())) lost(i, true, "hung up");
+		}
+		if (!error.empty()) break;
+
+		// wait for replies, no longer than until the next tile is due
+		std::vector<pollfd> fds;
+		std::vector<int> index;
+		double wait_ms = timeout_ms;
+		Clock::time_point now = Clock::now();
+		for (size_t i=0; i<workers.size(); i++) {
+			if (workers[i].tile<0) continue;
+			pollfd p = {workers[i].fd, POLLIN, 0};
+			fds.push_back(p);
+			index.push_back(i);
+			wait_ms = std::min(wait_ms, timeout_ms-std::chrono::duration<double, std::milli>(now-workers[i].sent).count());
+		}
+		if (fds.empty()) continue;
+		int ready = poll(fds.data(), fds.size(), (int)std::max(0., std::ceil(wait_ms)));
+		if (ready<0 && errno!=EINTR) {
+			error = std::string("can't poll workers: ") + strerror(errno);
+			break;
+		}
+
+		for (size_t j=0; j<fds.size() && error.empty(); j++) {
+			int i = index[j];
+			FarmWorker& w = workers[i];
+			if (fds[j].revents) {
+				char buf[1<<16];
+				ssize_t n = read(w.fd, buf, sizeof(buf));
+				if (n<0 && errno==EINTR) continue;
+				if (n<=0) {
+					lost(i, false, "died");
+					continue;
+				}
+				w.in.append(buf, n);
+				size_t nl = w.in.find('\n');
+				if (nl==std::string::npos) continue;
+				std::istringstream head(w.in.substr(0, nl));
+				std::string kind;
+				head >> kind;
+				if (kind=="error") {
+					error = nl>6 ? w.in.substr(6, nl-6) : "worker error";
+					break;
+				}
+				FarmTile& t = tiles[w.tile];
+				int x0, y0, tw, th;
+				if (kind!="tile" || !(head >> x0 >> y0 >> tw >> th) || x0!=t.x0 || y0!=t.y0 || tw!=t.w || th!=t.h) {
+					lost(i, true, "sent garbage");
+					continue;
+				}
+				size_t bytes = (size_t)t.w*t.h*3;
+				if (w.in.size()<nl+1+bytes) continue;
+				const unsigned char* src = (const unsigned char *)w.in.data()+nl+1;
+				for (int y=0; y<t.h; y++) {
+					memcpy(image.buffer()+((size_t)(t.y0+y)*job.width+t.x0)*3, src+(size_t)y*t.w*3, (size_t)t.w*3);
+				}
+				w.in.clear();
+				w.tile = -1;
+				done++;
+			} else if (std::chrono::duration<double, std::milli>(Clock::now()-w.sent).count() >= timeout_ms) {
+				lost(i, true, "timed out");
+			}
+		}
+	}
+
+	// hanging up is how workers are told to exit
+	for (size_t i=0; i<workers.size(); i++) if (workers[i].fd>=0) reap(workers[i], !error.empty());
+	if (!error.empty()) {
+		std::cerr << "can't render " << job.output << ": " << error << std::endl;
+		return 1;
+	}
+	if (!write_file(ConstImageView(image).flipped(), job.output.c_str())) {
+		std::cerr << "can't write " << job.output << std::endl;
+		return 1;
+	}
+	double ms = std::chrono::duration<double, std::milli>(Clock::now()-start).count();
+	std::cerr << "# farm: " << tiles.size() << " tiles on " << workers.size() << " workers, " << redispatched << " redispatched, " << ms << " ms" << std::endl;
+	return 0;
+}
@@ -0,0 +1,24 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_FARM_H
+#define TATE_FARM_H
+
+#include <string>
+
+const int FARM_TILE = 256;               // default tile edge in pixels
+const double FARM_TIMEOUT_MS = 10000;    // a tile still out after this long is taken back and handed to another worker
+const int FARM_MAX_TRIES = 3;            // times one tile is dispatched before the job gives up on it
+
+// renders one job, a line of the server protocol (see server.h), on nworkers forked worker processes.
+// the coordinator cuts the image into tile x tile pieces and hands them to idle workers over a socket pair
+// each, one request per line:
+//   <x0> <y0> <w> <h> <job line>
+// a worker renders just that window of the picture and answers with
+//   tile <x0> <y0> <w> <h>\n followed by w*h rgb pixels, bottom row first
+// or "error <message>\n" when the job itself is bad, which fails the whole job. a worker that dies, or
+// hasn't answered after timeout_ms, is killed and replaced and its tile goes back on the queue. nothing in
+// the protocol assumes the worker is local, it's bytes on a stream. returns 0 once output is written
+int render_farm(const std::string& job_line, int nworkers, int tile=FARM_TILE, double timeout_ms=FARM_TIMEOUT_MS);
+
+#endif // TATE_FARM_H
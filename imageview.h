@@ -0,0 +1,71 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_IMAGEVIEW_H
+#define TATE_IMAGEVIEW_H
+
+#include <cstddef>
+#include <cstring>
+#include "tgaimage.h"
+
+// a window onto pixels someone else owns: where row 0 starts and how many bytes it is from one row to the
+// next. a negative stride walks the rows backwards through memory, so flipped() turns a bottom-up image
+// into a top-down one (or back) without moving anything, and crop() is a sub-rectangle for tiles. Byte is
+// unsigned char for ImageView and const unsigned char for ConstImageView. get() and set() work like
+// TGAImage's
+template <class Byte> class BasicImageView {
+	Byte* origin;
+	int width, height, bytespp;
+	ptrdiff_t stride;
+public:
+	BasicImageView() : origin(NULL), width(0), height(0), bytespp(0), stride(0) {}
+	BasicImageView(Byte* origin, int width, int height, int bytespp, ptrdiff_t stride) : origin(origin), width(width), height(height), bytespp(bytespp), stride(stride) {}
+	// the whole image with its rows in memory order
+	BasicImageView(TGAImage& img) : origin(img.buffer()), width(img.get_width()), height(img.get_height()), bytespp(img.get_bytespp()), stride((ptrdiff_t)img.get_width()*img.get_bytespp()) {}
+	BasicImageView(const TGAImage& img) : origin(img.buffer()), width(img.get_width()), height(img.get_height()), bytespp(img.get_bytespp()), stride((ptrdiff_t)img.get_width()*img.get_bytespp()) {}
+	// ImageView converts to ConstImageView
+	template <class B> BasicImageView(const BasicImageView<B>& v) : origin(v.row(0)), width(v.get_width()), height(v.get_height()), bytespp(v.get_bytespp()), stride(v.get_stride()) {}
+
+	int get_width() const { return width; }
+	int get_height() const { return height; }
+	int get_bytespp() const { return bytespp; }
+	ptrdiff_t get_stride() const { return stride; }
+	bool contiguous() const { return stride==(ptrdiff_t)width*bytespp; }
+	Byte* row(int y) const { return origin+y*stride; }
+	Byte* pixel(int x, int y) const { return origin+y*stride+x*bytespp; }
+
+	TGAColor get(int x, int y) const {
+		if (!origin || x<0 || y<0 || x>=width || y>=height) return TGAColor();
+		return TGAColor(pixel(x, y), bytespp);
+	}
+	bool set(int x, int y, const TGAColor& c) const {
+		if (!origin || x<0 || y<0 || x>=width || y>=height) return false;
+		memcpy(pixel(x, y), c.raw, bytespp);
+		return true;
+	}
+
+	// the same pixels with the last row first
+	BasicImageView flipped() const {
+		if (height==0) return *this;
+		return BasicImageView(row(height-1), width, height, bytespp, -stride);
+	}
+	// w x h pixels starting at x,y, clipped to this view
+	BasicImageView crop(int x, int y, int w, int h) const {
+		if (x<0) { w += x; x = 0; }
+		if (y<0) { h += y; y = 0; }
+		if (x+w>width) w = width-x;
+		if (y+h>height) h = height-y;
+		if (w<=0 || h<=0) return BasicImageView(origin, 0, 0, bytespp, stride);
+		return BasicImageView(pixel(x, y), w, h, bytespp, stride);
+	}
+};
+
+typedef BasicImageView<unsigned char> ImageView;
+typedef BasicImageView<const unsigned char> ConstImageView;
+
+// the TGAImage writers take views, so an image can be written bottom-up or cropped without a copy
+bool write_tga_file(const ConstImageView& view, const char *filename, bool rle=true);
+bool write_qoi_file(const ConstImageView& view, const char *filename);
+bool write_file(const ConstImageView& view, const char *filename);
+
+#endif // TATE_IMAGEVIEW_H
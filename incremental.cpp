@@ -0,0 +1,128 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <vector>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include "tgaimage.h"
+#include "geometry.h"
+#include "model.h"
+#include "renderer.h"
+#include "incremental.h"
+#include "bctexture.h"
+
+template <class Texture> IncrementalRenderer<Texture>::IncrementalRenderer(int width, int height)
+	: image_(width, height, TGAImage::RGB), w(width), h(height), tw((width+DIRTY_TILE-1)/DIRTY_TILE), th((height+DIRTY_TILE-1)/DIRTY_TILE),
+	zbuffer(new int[width*height]), scratch(new int[width*height]), all_dirty(true), prev(), prev_rects(), prev_visible(), forced(), prev_light(), prev_camera() {
+	clear_zbuffer(zbuffer, w, h);
+}
+
+template <class Texture> IncrementalRenderer<Texture>::~IncrementalRenderer() {
+	delete[] zbuffer;
+	delete[] scratch;
+}
+
+template <class Texture> void IncrementalRenderer<Texture>::invalidate() {
+	all_dirty = true;
+}
+
+template <class Texture> void IncrementalRenderer<Texture>::invalidate(int object) {
+	forced.push_back(object);
+}
+
+template <class Texture> void IncrementalRenderer<Texture>::mark(std::vector<bool>& dirty, const ScreenRect& r) {
+	for (int ty=r.y0/DIRTY_TILE; ty<=r.y1/DIRTY_TILE; ty++) {
+		for (int tx=r.x0/DIRTY_TILE; tx<=r.x1/DIRTY_TILE; tx++) {
+			dirty[tx+ty*tw] = true;
+		}
+	}
+}
+
+template <class Texture> bool IncrementalRenderer<Texture>::touches(const std::vector<bool>& dirty, const ScreenRect& r) const {
+	for (int ty=r.y0/DIRTY_TILE; ty<=r.y1/DIRTY_TILE; ty++) {
+		for (int tx=r.x0/DIRTY_TILE; tx<=r.x1/DIRTY_TILE; tx++) {
+			if (dirty[tx+ty*tw]) return true;
+		}
+	}
+	return false;
+}
+
+static bool same_object(const Model* m0, const void* t0, const Instance& a, const Model* m1, const void* t1, const Instance& b) {
+	return m0==m1 && t0==t1 && a.scale==b.scale && a.offset.x==b.offset.x && a.offset.y==b.offset.y && a.offset.z==b.offset.z;
+}
+
+static bool same_vec(Vec3f a, Vec3f b) {
+	return a.x==b.x && a.y==b.y && a.z==b.z;
+}
+
+template <class Texture> int IncrementalRenderer<Texture>::render(const std::vector<SceneObject<Texture>>& objects, Vec3f light_source, Vec3f camera_pos, RenderStats* stats) {
+	int n = (int)objects.size();
+	std::vector<ScreenRect> rects(n);
+	std::vector<bool> visible(n);
+	for (int i=0; i<n; i++) {
+		visible[i] = objects[i].model && objects[i].texture && screen_rect(objects[i].model, objects[i].xf, w, h, camera_pos, rects[i]);
+	}
+
+	// work out which tiles changed
+	bool everything = all_dirty || !same_vec(light_source, prev_light) || !same_vec(camera_pos, prev_camera);
+	std::vector<bool> dirty(tw*th, everything);
+	if (!everything) {
+		std::vector<bool> changed(std::max(n, (int)prev.size()), false);
+		for (size_t k=0; k<forced.size(); k++) {
+			if (forced[k]>=0 && forced[k]<(int)changed.size()) changed[forced[k]] = true;
+		}
+		for (int i=0; i<(int)changed.size(); i++) {
+			if (i<n && i<(int)prev.size() && !changed[i] && same_object(objects[i].model, objects[i].texture, objects[i].xf, prev[i].model, prev[i].texture, prev[i].xf)) continue;
+			// what it covered before has to be redrawn without it, and where it is now with it
+			if (i<(int)prev.size() && prev_visible[i]) mark(dirty, prev_rects[i]);
+			if (i<n && visible[i]) mark(dirty, rects[i]);
+		}
+	}
+	forced.clear();
+	all_dirty = false;
+	prev = objects;
+	prev_rects = rects;
+	prev_visible = visible;
+	prev_light = light_source;
+	prev_camera = camera_pos;
+
+	int ndirty = (int)std::count(dirty.begin(), dirty.end(), true);
+	if (ndirty==0) return 0;
+
+	// clear the dirty tiles. the clean ones keep their pixels and get the nearest possible depth in the
+	// scratch zbuffer, so every fragment there fails the depth test and the hi-z culls whole meshlets over them
+	unsigned char* pixels = image_.buffer();
+	int bpp = image_.get_bytespp();
+	for (int ty=0; ty<th; ty++) {
+		for (int tx=0; tx<tw; tx++) {
+			bool d = dirty[tx+ty*tw];
+			int x0 = tx*DIRTY_TILE, x1 = std::min(w, x0+DIRTY_TILE);
+			for (int y=ty*DIRTY_TILE; y<std::min(h, (ty+1)*DIRTY_TILE); y++) {
+				std::fill(scratch+x0+y*w, scratch+x1+y*w, d ? std::numeric_limits<int>::min() : std::numeric_limits<int>::max());
+				if (d) memset(pixels+(x0+(size_t)y*w)*bpp, 0, (x1-x0)*bpp);
+			}
+		}
+	}
+
+	// redraw everything that reaches into a dirty tile, in scene order like a full render would
+	for (int i=0; i<n; i++) {
+		if (!visible[i] || !touches(dirty, rects[i])) continue;
+		::render(objects[i].model, *objects[i].texture, image_, scratch, objects[i].xf, light_source, camera_pos, stats);
+	}
+
+	// keep the new depth of the dirty tiles
+	for (int ty=0; ty<th; ty++) {
+		for (int tx=0; tx<tw; tx++) {
+			if (!dirty[tx+ty*tw]) continue;
+			int x0 = tx*DIRTY_TILE, x1 = std::min(w, x0+DIRTY_TILE);
+			for (int y=ty*DIRTY_TILE; y<std::min(h, (ty+1)*DIRTY_TILE); y++) {
+				std::copy(scratch+x0+y*w, scratch+x1+y*w, zbuffer+x0+y*w);
+			}
+		}
+	}
+	return ndirty;
+}
+
+template class IncrementalRenderer<TGAImage>;
+template class IncrementalRenderer<BCTexture>;
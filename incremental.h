@@ -0,0 +1,56 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_INCREMENTAL_H
+#define TATE_INCREMENTAL_H
+
+#include <vector>
+#include "tgaimage.h"
+#include "geometry.h"
+#include "model.h"
+#include "renderer.h"
+
+const int DIRTY_TILE = 32; // side of the tiles that get invalidated, in pixels
+
+// one thing in an IncrementalRenderer scene. objects are matched between frames by their index
+template <class Texture> struct SceneObject {
+	const Model* model;
+	const Texture* texture;
+	Instance xf;
+	SceneObject() : model(NULL), texture(NULL), xf() {}
+	SceneObject(const Model* model, const Texture* texture, const Instance& xf) : model(model), texture(texture), xf(xf) {}
+};
+
+// keeps the color and depth buffers between frames and only redraws the tiles that something changed.
+// a tile is dirty when an object that moved, appeared, disappeared or was invalidated covered it last
+// frame or covers it now. a new light or camera redraws everything
+template <class Texture> class IncrementalRenderer {
+public:
+	IncrementalRenderer(int width, int height);
+	IncrementalRenderer(const IncrementalRenderer&) = delete;
+	IncrementalRenderer& operator=(const IncrementalRenderer&) = delete;
+	~IncrementalRenderer();
+	// brings image() up to date with the scene, returns how many tiles were redrawn
+	int render(const std::vector<SceneObject<Texture>>& objects, Vec3f light_source, Vec3f camera_pos, RenderStats* stats=NULL);
+	// for changes render() can't see, eg. a model or texture edited in place
+	void invalidate();
+	void invalidate(int object);
+	const TGAImage& image() const { return image_; }
+	const int* depth() const { return zbuffer; }
+	int ntiles() const { return tw*th; }
+private:
+	TGAImage image_;
+	int w, h, tw, th;
+	int* zbuffer;
+	int* scratch; // depth while drawing, clean tiles are pinned to the nearest depth so nothing lands there
+	bool all_dirty;
+	std::vector<SceneObject<Texture>> prev;
+	std::vector<ScreenRect> prev_rects;
+	std::vector<bool> prev_visible;
+	std::vector<int> forced;
+	Vec3f prev_light, prev_camera;
+	void mark(std::vector<bool>& dirty, const ScreenRect& r);
+	bool touches(const std::vector<bool>& dirty, const ScreenRect& r) const;
+};
+
+#endif // TATE_INCREMENTAL_H
@@ -0,0 +1,299 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdio>
+#include <vector>
+#include <queue>
+#include <algorithm>
+#include <cmath>
+#include <sys/stat.h>
+#include "geometry.h"
+#include "model.h"
+#include "meshopt.h"
+#include "bvh.h"
+#include "lod.h"
+
+// symmetric 4x4 error quadric, upper triangle only
+struct Quadric {
+	double q[10];
+	Quadric() { for (int i=0; i<10; i++) q[i] = 0; }
+	// quadric of the plane ax+by+cz+d=0, weighted by w
+	Quadric(double a, double b, double c, double d, double w) {
+		q[0]=a*a*w; q[1]=a*b*w; q[2]=a*c*w; q[3]=a*d*w;
+		q[4]=b*b*w; q[5]=b*c*w; q[6]=b*d*w;
+		q[7]=c*c*w; q[8]=c*d*w;
+		q[9]=d*d*w;
+	}
+	Quadric& operator+=(const Quadric& o) { for (int i=0; i<10; i++) q[i] += o.q[i]; return *this; }
+	// squared distance of p to the planes in the quadric
+	double error(Vec3f p) const {
+		double x=p.x, y=p.y, z=p.z;
+		return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x
+		     + q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y
+		     + q[7]*z*z + 2*q[8]*z
+		     + q[9];
+	}
+};
+
+// half edge collapse u->v, valid while neither vertex has changed since it was queued
+struct Collapse {
+	double cost;
+	int u, v;
+	int stamp_u, stamp_v;
+	bool operator<(const Collapse& o) const { return cost > o.cost; } // smallest cost on top of the heap
+};
+
+// quadric error simplification by half edge collapses (Garland & Heckbert, 1997).
+// vertices keep their position and uv, so collapsing u into v only ever moves corners of u onto v.
+// uv seam and open boundary vertices are never removed, so the diffuse texture still maps
+Model* simplify(const Model* model, int target_faces) {
+	int nv = model->nverts();
+	int nf = model->nfaces();
+	std::vector<Vec3f> pos(nv);
+	for (int i=0; i<nv; i++) pos[i] = model->vert(i);
+	std::vector<std::vector<Vec3i>> faces(nf);
+	for (int i=0; i<nf; i++) {
+		faces[i] = model->face(i);
+		std::swap(faces[i][1].iuv, faces[i][2].iuv); // back to real corners, see Model::Model
+	}
+
+	std::vector<bool> face_alive(nf, true);
+	std::vector<std::vector<int>> vfaces(nv);
+	std::vector<Quadric> quadric(nv);
+	for (int i=0; i<nf; i++) {
+		Vec3f n = (pos[faces[i][1].ivert]-pos[faces[i][0].ivert])^(pos[faces[i][2].ivert]-pos[faces[i][0].ivert]);
+		float area = n.norm();
+		if (area>0) n = n*(1.f/area);
+		Quadric q = Quadric(n.x, n.y, n.z, -(n*pos[faces[i][0].ivert]), area);
+		for (int j=0; j<3; j++) {
+			vfaces[faces[i][j].ivert].push_back(i);
+			quadric[faces[i][j].ivert] += q;
+		}
+	}
+
+	// lock vertices with more than one uv and vertices on an open edge
+	std::vector<bool> locked(nv, false);
+	for (int v=0; v<nv; v++) {
+		int uv = -1;
+		std::vector<int> ring; // each neighbour appears once per edge, twice for an interior edge
+		for (size_t k=0; k<vfaces[v].size(); k++) {
+			std::vector<Vec3i>& f = faces[vfaces[v][k]];
+			for (int j=0; j<3; j++) {
+				if (f[j].ivert==v) {
+					if (uv>=0 && f[j].iuv!=uv) locked[v] = true;
+					uv = f[j].iuv;
+				} else {
+					ring.push_back(f[j].ivert);
+				}
+			}
+		}
+		std::sort(ring.begin(), ring.end());
+		for (size_t k=0; k<ring.size(); ) {
+			size_t e = k;
+			while (e<ring.size() && ring[e]==ring[k]) e++;
+			if (e-k!=2) locked[v] = true;
+			k = e;
+		}
+	}
+
+	std::vector<int> stamp(nv, 0);
+	std::priority_queue<Collapse> heap;
+	// queue both directions of every edge around v
+	auto push_edges = [&](int v) {
+		for (size_t k=0; k<vfaces[v].size(); k++) {
+			std::vector<Vec3i>& f = faces[vfaces[v][k]];
+			for (int j=0; j<3; j++) {
+				int w = f[j].ivert;
+				if (w==v) continue;
+				Quadric q = quadric[v];
+				q += quadric[w];
+				if (!locked[v]) heap.push(Collapse{q.error(pos[w]), v, w, stamp[v], stamp[w]});
+				if (!locked[w]) heap.push(Collapse{q.error(pos[v]), w, v, stamp[w], stamp[v]});
+			}
+		}
+	};
+	for (int v=0; v<nv; v++) push_edges(v);
+
+	int alive = nf;
+	std::vector<int> mark(nv, -1);
+	int attempt = 0;
+	while (alive>target_faces && !heap.empty()) {
+		Collapse c = heap.top();
+		heap.pop();
+		int u = c.u, v = c.v;
+		if (stamp[u]!=c.stamp_u || stamp[v]!=c.stamp_v || stamp[u]<0) continue;
+
+		// the faces on edge uv go away, the rest of u's faces move their u corner onto v
+		int shared = 0;
+		Vec3i v_corner;
+		for (size_t k=0; k<vfaces[u].size(); k++) {
+			std::vector<Vec3i>& f = faces[vfaces[u][k]];
+			for (int j=0; j<3; j++) {
+				if (f[j].ivert==v) { shared++; v_corner = f[j]; }
+			}
+		}
+		if (shared==0) continue;
+
+		// link condition: u and v may only share the neighbours opposite the edge, or the mesh folds over
+		attempt++;
+		for (size_t k=0; k<vfaces[v].size(); k++) {
+			std::vector<Vec3i>& f = faces[vfaces[v][k]];
+			for (int j=0; j<3; j++) mark[f[j].ivert] = attempt;
+		}
+		int common = 0;
+		for (size_t k=0; k<vfaces[u].size(); k++) {
+			std::vector<Vec3i>& f = faces[vfaces[u][k]];
+			for (int j=0; j<3; j++) {
+				int w = f[j].ivert;
+				if (w!=u && w!=v && mark[w]==attempt) { common++; mark[w] = -1; }
+			}
+		}
+		if (common!=shared) continue;
+
+		// don't let any remaining face flip over
+		bool flips = false;
+		for (size_t k=0; k<vfaces[u].size() && !flips; k++) {
+			std::vector<Vec3i>& f = faces[vfaces[u][k]];
+			if (f[0].ivert==v || f[1].ivert==v || f[2].ivert==v) continue;
+			Vec3f p[3], q[3];
+			for (int j=0; j<3; j++) {
+				p[j] = pos[f[j].ivert];
+				q[j] = f[j].ivert==u ? pos[v] : p[j];
+			}
+			Vec3f n0 = (p[1]-p[0])^(p[2]-p[0]);
+			Vec3f n1 = (q[1]-q[0])^(q[2]-q[0]);
+			if (n0*n1 <= .1f*n0.norm()*n1.norm()) flips = true;
+		}
+		if (flips) continue;
+
+		for (size_t k=0; k<vfaces[u].size(); k++) {
+			int fi = vfaces[u][k];
+			std::vector<Vec3i>& f = faces[fi];
+			if (f[0].ivert==v || f[1].ivert==v || f[2].ivert==v) {
+				face_alive[fi] = false;
+				alive--;
+				for (int j=0; j<3; j++) {
+					int w = f[j].ivert;
+					if (w==u) continue;
+					vfaces[w].erase(std::find(vfaces[w].begin(), vfaces[w].end(), fi));
+				}
+			} else {
+				for (int j=0; j<3; j++) {
+					if (f[j].ivert==u) f[j] = v_corner;
+				}
+				vfaces[v].push_back(fi);
+			}
+		}
+		vfaces[u].clear();
+		quadric[v] += quadric[u];
+		stamp[u] = -1;
+		stamp[v]++;
+		for (size_t k=0; k<vfaces[v].size(); k++) {
+			std::vector<Vec3i>& f = faces[vfaces[v][k]];
+			for (int j=0; j<3; j++) {
+				if (f[j].ivert!=v) stamp[f[j].ivert]++;
+			}
+		}
+		push_edges(v);
+		for (size_t k=0; k<vfaces[v].size(); k++) {
+			std::vector<Vec3i>& f = faces[vfaces[v][k]];
+			for (int j=0; j<3; j++) {
+				if (f[j].ivert!=v) push_edges(f[j].ivert);
+			}
+		}
+	}
+
+	// drop everything the remaining faces don't use
+	std::vector<int> vmap(nv, -1), tmap(model->ntexture_verts(), -1), nmap(model->nnormal_verts(), -1);
+	std::vector<Vec3f> verts, normals;
+	std::vector<Vec2f> uvs;
+	std::vector<std::vector<Vec3i>> out_faces;
+	for (int i=0; i<nf; i++) {
+		if (!face_alive[i]) continue;
+		std::vector<Vec3i> f = faces[i];
+		for (int j=0; j<3; j++) {
+			if (vmap[f[j].ivert]<0) { vmap[f[j].ivert] = verts.size(); verts.push_back(pos[f[j].ivert]); }
+			if (f[j].iuv>=0 && tmap[f[j].iuv]<0) { tmap[f[j].iuv] = uvs.size(); uvs.push_back(model->texture_vert(f[j].iuv)); }
+			if (f[j].inorm>=0 && nmap[f[j].inorm]<0) { nmap[f[j].inorm] = normals.size(); normals.push_back(model->normal_vert(f[j].inorm)); }
+			f[j] = Vec3i(vmap[f[j].ivert], f[j].iuv>=0 ? tmap[f[j].iuv] : -1, f[j].inorm>=0 ? nmap[f[j].inorm] : -1);
+		}
+		std::swap(f[1].iuv, f[2].iuv);
+		out_faces.push_back(f);
+	}
+	return new Model(verts, uvs, normals, out_faces);
+}
+
+// obj/african_head/african_head.obj -> obj/african_head/african_head.lod2.obj
+std::string lod_path(const char *filename, int level) {
+	std::string path = filename;
+	size_t dot = path.rfind('.');
+	size_t slash = path.rfind('/');
+	if (dot==std::string::npos || (slash!=std::string::npos && dot<slash)) dot = path.size();
+	return path.substr(0, dot) + ".lod" + std::to_string(level) + path.substr(dot);
+}
+
+static bool newer_than(const std::string& a, const char *b) {
+	struct stat sa, sb;
+	if (stat(a.c_str(), &sa)!=0 || stat(b, &sb)!=0) return false;
+	return sa.st_mtime >= sb.st_mtime;
+}
+
+// first line of a cached level, what it was built with
+static std::string lod_comment(int level, int nlevels) {
+	char buf[96];
+	snprintf(buf, sizeof(buf), "lod %d of %d, reduction %g", level, nlevels, LOD_REDUCTION);
+	return buf;
+}
+
+static bool first_line_is(const std::string& path, const std::string& line) {
+	std::ifstream in(path.c_str());
+	std::string first;
+	return std::getline(in, first) && first==line;
+}
+
+LODChain::LODChain(const char *filename, int nlevels) : levels_() {
+	Model* full = new Model(filename);
+	levels_.push_back(full);
+	for (int level=1; level<nlevels; level++) {
+		Model* prev = levels_.back();
+		std::string path = lod_path(filename, level);
+		std::string comment = lod_comment(level, nlevels);
+		bool cached = newer_than(path, filename) && first_line_is(path, "# " + comment);
+		Model* lod = cached ? new Model(path.c_str()) : simplify(prev, (int)(prev->nfaces()*LOD_REDUCTION));
+		// stop once simplification can't make any more progress. only kept levels get cached, or a model that
+		// didn't load would leave files the next run takes for real levels
+		if (lod->nfaces()==0 || lod->nfaces()>=prev->nfaces()) {
+			delete lod;
+			break;
+		}
+		if (!cached) lod->write_obj(path.c_str(), comment);
+		levels_.push_back(lod);
+	}
+	for (size_t i=0; i<levels_.size(); i++) {
+		optimize_mesh(levels_[i]);
+		build_bvh(levels_[i]);
+	}
+}
+
+LODChain::~LODChain() {
+	for (size_t i=0; i<levels_.size(); i++) delete levels_[i];
+}
+
+int LODChain::nlevels() {
+	return (int)levels_.size();
+}
+
+Model* LODChain::level(int i) {
+	return levels_[i];
+}
+
+// finest level that still gets LOD_PIXELS_PER_FACE pixels of screen area per face
+int LODChain::select(float screen_area) {
+	for (int i=0; i<(int)levels_.size(); i++) {
+		if (levels_[i]->nfaces()*LOD_PIXELS_PER_FACE <= screen_area) return i;
+	}
+	return (int)levels_.size()-1;
+}
@@ -0,0 +1,34 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_LOD_H
+#define TATE_LOD_H
+
+#include <string>
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+
+const int LOD_LEVELS = 5;            // levels in a chain, including the full model
+const float LOD_REDUCTION = .5f;     // each level keeps this fraction of the faces of the one before
+const float LOD_PIXELS_PER_FACE = 8; // pick the finest level with at least this much screen area per face
+
+Model* simplify(const Model* model, int target_faces);
+std::string lod_path(const char *filename, int level);
+
+// a model and its simplified versions, coarsest last. levels are cached next to the asset as
+// <name>.lod<level>.obj, with the chain's parameters on the first line. they're rebuilt when the original
+// is newer or the parameters differ
+class LODChain {
+	std::vector<Model*> levels_;
+public:
+	LODChain(const char *filename, int nlevels=LOD_LEVELS);
+	LODChain(const LODChain&) = delete;
+	LODChain& operator=(const LODChain&) = delete;
+	~LODChain();
+	int nlevels();
+	Model* level(int i);
+	int select(float screen_area);
+};
+
+#endif // TATE_LOD_H
@@ -4,41 +4,382 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <string>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <unistd.h>
 #include "tgaimage.h"
 #include "geometry.h"
 #include "model.h"
 #include "renderer.h"
+#include "assets.h"
+#include "server.h"
+#include "videosink.h"
+#include "regress.h"
+#include "ssao.h"
+#include "threadpool.h"
+#include "oit.h"
+#include "mappedtga.h"
+#include "progressive.h"
+#include "farm.h"
+#include "composite.h"
+#include "trace.h"
+#include "lod.h"
+#include "incremental.h"
 
 // Globals
-Model *model = NULL;
-TGAImage model_uv;
 const int width  = 1000;
 const int height = 1000;
 
 
-int main(int argc, char** argv) {
-	if (argc >= 2) {
-		model = new Model(argv[1]);
-	} else {
-		model = new Model("obj/african_head/african_head.obj");
+// the normal or specular map that goes with a diffuse map, eg. head_diffuse.tga -> head_nm_tangent.tga.
+// empty when there's no such file
+std::string sibling_map(const std::string& diffuse_path, const char *suffix) {
+	size_t i = diffuse_path.rfind("_diffuse");
+	if (i==std::string::npos) return "";
+	std::string path = diffuse_path.substr(0, i) + suffix + diffuse_path.substr(i+strlen("_diffuse"));
+	return access(path.c_str(), R_OK)==0 ? path : "";
+}
+
+// the diffuse map that goes with a model, eg. eye_outer.obj -> eye_outer_diffuse.tga
+std::string diffuse_map(const std::string& model_path) {
+	size_t i = model_path.rfind(".obj");
+	if (i==std::string::npos) return "";
+	return model_path.substr(0, i) + "_diffuse.tga";
+}
+
+// a texture loading on the loader pool, or one that was never asked for
+template <class Texture> using TextureLoad = std::shared_future<std::shared_ptr<const Texture>>;
+// starts one loading. normal_map is for tangent space normal maps, which compress to their own format
+template <class Texture> using TextureLoader = std::function<TextureLoad<Texture>(const std::string& path, bool normal_map)>;
+
+// waits for a load, a load that was never started is an empty handle
+template <class Handle> Handle wait_for(const std::shared_future<Handle>& load) {
+	return load.valid() ? load.get() : Handle();
+}
+
+// renders a still to output_path, or a light turntable of frames to video_path. with a normal map or
+// specular map the model gets per-pixel lighting. ao is 0 for none, 1 for full resolution ssao, 2 for half.
+// shell, if there is one, is drawn translucent over the rest. mapped renders the still straight into the
+// pages of an uncompressed tga instead of a buffer that's written out afterwards. compact, if given, is drawn
+// in place of model. the textures can still be loading, they're waited for once the buffers are set up
+template <class Texture> int render_frames(const Model* model, const CompactMesh* compact, TextureLoad<Texture> model_uv_load, TextureLoad<Texture> normal_map_load, TextureLoad<Texture> specular_load, int ao,
+	const Model* shell, TextureLoad<Texture> shell_uv_load, const char *output_path, const char *video_path, bool raw, bool mapped, int frames) {
+	std::vector<int> zbuffer(width*height);
+	std::vector<float> occlusion;
+	std::unique_ptr<ThreadPool> pool(ao || shell ? new ThreadPool() : NULL);
+	std::shared_ptr<const Texture> model_uv = wait_for(model_uv_load), normal_map = wait_for(normal_map_load);
+	std::shared_ptr<const Texture> specular = wait_for(specular_load), shell_uv = wait_for(shell_uv_load);
+	if (!model_uv) return 1;
+	// a map that was asked for and didn't load would quietly drop the lighting it's for
+	if ((normal_map_load.valid() && !normal_map) || (specular_load.valid() && !specular)) return 1;
+	Material<Texture> mat(model_uv.get(), normal_map.get(), specular.get());
+	bool phong = normal_map || specular;
+	std::unique_ptr<OITBuffer> oit(shell && shell_uv ? new OITBuffer(width, height) : NULL);
+	auto draw = [&](const ImageView& image, Vec3f light_source) {
+		Vec3f camera_pos = Vec3f(0,0,3);
+		clear_zbuffer(zbuffer.data(), width, height);
+		if (phong) render_phong(model, mat, image, zbuffer.data(), Instance(), light_source, camera_pos);
+		else if (compact) render(compact, *model_uv, image, zbuffer.data(), Instance(), light_source, camera_pos);
+		else render(model, *model_uv, image, zbuffer.data(), Instance(), light_source, camera_pos);
+		if (ao) {
+			ssao(zbuffer.data(), width, height, camera_pos, occlusion, ao==2, pool.get());
+			apply_ao(image, occlusion);
+		}
+		if (oit) {
+			oit->clear();
+			render_transparent(shell, *shell_uv, *oit, zbuffer.data(), Instance(), light_source, camera_pos);
+			oit->resolve(image, pool.get());
+			if (oit->overflow()) std::cerr << "# oit arena full, " << oit->overflow() << " fragments merged or dropped" << std::endl;
+		}
+	};
+
+	if (video_path) {
+		// light turntable, every frame goes straight from the framebuffer into the stream
+		VideoSink sink(video_path, raw ? VideoSink::RAW_RGB : VideoSink::Y4M, width, height);
+		TGAImage image = TGAImage(width, height, TGAImage::RGB);
+		for (int f=0; f<frames && sink.good(); f++) {
+			float a = 2*M_PI*f/frames;
+			image.clear();
+			draw(image, Vec3f(std::sin(a),0,-std::cos(a)));
+			sink.write_frame(ConstImageView(image).flipped());
+		}
+		std::cerr << "# wrote " << sink.frames() << " frames" << std::endl;
+		return sink.frames()==frames ? 0 : 1;
 	}
-	if (argc >= 3) {
-		model_uv.read_tga_file(argv[2]);
-	} else {
-		model_uv.read_tga_file("obj/african_head/african_head_diffuse.tga");
+
+	if (mapped) {
+		// a new file reads as zeros, so the mapping starts out cleared to black
+		MappedTGA out(output_path, width, height, TGAImage::RGB);
+		if (!out.good()) return 1;
+		draw(out.view(), Vec3f(0,0,-1));
+		return out.close() ? 0 : 1;
 	}
-	model_uv.flip_vertically();
 
-	// create image
-	TGAImage image = TGAImage(width, height, TGAImage::RGB);
 	// render model
-	render(model, model_uv, image, Vec3f(0,0,-1), Vec3f(0,0,3));
+	TGAImage image = TGAImage(width, height, TGAImage::RGB);
+	draw(image, Vec3f(0,0,-1));
 
-	image.flip_vertically(); // i want to have the origin at the left bottom corner of the image
-	image.scale(width, height);
-	image.write_tga_file("output.tga");
+	// i want to have the origin at the left bottom corner of the image, so it's written through a flipped view
+	write_file(ConstImageView(image).flipped(), output_path);
+
+	return 0;
+}
+
+// renders a still coarse to fine within budget_ms, noting when each pass arrives, and writes the last one
+template <class Texture> int render_progressive_still(const Model* model, std::shared_ptr<const Texture> model_uv, const char *output_path, double budget_ms) {
+	if (!model_uv) return 1;
+	TGAImage image = TGAImage(width, height, TGAImage::RGB);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	render_progressive(model, *model_uv, width, height, Vec3f(0,0,-1), Vec3f(0,0,3), budget_ms, [&](const ConstImageView& frame, int step) {
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+		std::cerr << "# step " << step << " after " << ms << " ms" << std::endl;
+		upscale_nearest(frame, step, image);
+		return true;
+	});
+	write_file(ConstImageView(image).flipped(), output_path);
+	return 0;
+}
+
+// renders each model with its texture on a thread of its own into its own buffers and depth composites
+// them. a part is loaded on the thread that draws it, so the big ones load while the small ones draw
+template <class Texture> int render_parts_still(const std::vector<std::string>& models, const std::vector<std::string>& textures,
+	std::function<std::shared_ptr<const Texture>(const std::string&)> load_texture, AssetCache& assets, const char *output_path) {
+	int n = (int)models.size();
+	std::vector<ModelHandle> held_models(n);
+	std::vector<std::shared_ptr<const Texture>> held_textures(n);
+	TGAImage image = TGAImage(width, height, TGAImage::RGB);
+	std::vector<int> zbuffer(width*height);
+	clear_zbuffer(zbuffer.data(), width, height);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	render_parts<Texture>(n, [&](int i, RenderPart<Texture>& part) {
+		held_models[i] = assets.model(models[i]);
+		held_textures[i] = load_texture(textures[i]);
+		part = RenderPart<Texture>(held_models[i].get(), held_textures[i].get());
+		return held_models[i] && held_textures[i];
+	}, image, zbuffer.data(), Vec3f(0,0,-1), Vec3f(0,0,3), &shared_pool());
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+	for (int i=0; i<n; i++) {
+		if (!held_models[i] || !held_textures[i]) {
+			std::cerr << "can't load part " << models[i] << " with " << textures[i] << std::endl;
+			return 1;
+		}
+	}
+	std::cerr << "# " << n << " parts loaded, drawn and composited in " << ms << " ms" << std::endl;
+	write_file(ConstImageView(image).flipped(), output_path);
+	return 0;
+}
 
-	delete model;
+// n copies of the model in receding rows, each drawn at the level of detail its size on screen calls for.
+// with a video_path a wave runs through the crowd instead, one copy hopping per frame, and every frame only
+// redraws the tiles around the two that moved
+template <class Texture> int render_crowd(const char *model_path, const Texture* model_uv, int n, const char *output_path, const char *video_path, bool raw, int frames) {
+	if (!model_uv) return 1;
+	LODChain lods(model_path);
+	if (!lods.level(0)->nfaces()) {
+		std::cerr << "can't load model " << model_path << std::endl;
+		return 1;
+	}
+	Vec3f camera_pos(0,0,3);
+	std::vector<Instance> instances = crowd_instances(n, camera_pos);
+	if (video_path) {
+		VideoSink sink(video_path, raw ? VideoSink::RAW_RGB : VideoSink::Y4M, width, height);
+		IncrementalRenderer<Texture> renderer(width, height);
+		std::vector<SceneObject<Texture>> objects(n);
+		long redrawn = 0;
+		for (int f=0; f<frames && sink.good(); f++) {
+			for (int i=0; i<n; i++) {
+				Instance xf = instances[i];
+				if (i==f%n) xf.offset.y += .5f*xf.scale;
+				objects[i] = SceneObject<Texture>(lods.level(lods.select(screen_area(lods.level(0), xf, width/2, camera_pos))), model_uv, xf);
+			}
+			redrawn += renderer.render(objects, Vec3f(0,0,-1), camera_pos);
+			sink.write_frame(ConstImageView(renderer.image()).flipped());
+		}
+		std::cerr << "# wrote " << sink.frames() << " frames, " << (sink.frames() ? redrawn/sink.frames() : 0) << " of " << renderer.ntiles() << " tiles redrawn per frame" << std::endl;
+		return sink.frames()==frames ? 0 : 1;
+	}
+	std::vector<int> uses(lods.nlevels(), 0);
+	for (size_t i=0; i<instances.size(); i++) uses[lods.select(screen_area(lods.level(0), instances[i], width/2, camera_pos))]++;
+	TGAImage image(width, height, TGAImage::RGB);
+	RenderStats stats;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	render_instances(lods, instances, *model_uv, image, Vec3f(0,0,-1), camera_pos, &stats);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-start).count();
+	std::cerr << "# crowd of " << n << " drawn in " << ms << " ms, " << stats.faces << " faces, instances per level:";
+	for (int i=0; i<lods.nlevels(); i++) std::cerr << " " << uses[i] << "x" << lods.level(i)->nfaces();
+	std::cerr << std::endl;
+	write_file(ConstImageView(image).flipped(), output_path);
 	return 0;
 }
 
+// starts every texture the render needs, and the shell, loading on loaders and loads the model meanwhile.
+// rendering starts once the model is in, the textures are waited for when they're first needed. nm_path and
+// spec_path are the phong maps, empty for none
+template <class Texture> int render_still(AssetCache& assets, ThreadPool& loaders, const TextureLoader<Texture>& load_texture, const char *model_path, const char *texture_path, bool quantize,
+	const std::string& nm_path, const std::string& spec_path, int ao, const char *shell_path, double budget_ms, const char *output_path, const char *video_path, bool raw, bool mapped, int frames) {
+	TextureLoad<Texture> diffuse = load_texture(texture_path, false);
+	TextureLoad<Texture> normal_map = nm_path.empty() ? TextureLoad<Texture>() : load_texture(nm_path, true);
+	TextureLoad<Texture> specular = spec_path.empty() ? TextureLoad<Texture>() : load_texture(spec_path, false);
+	// --oit draws a second, translucent model with its own diffuse map, eg. the african head's eye_outer
+	std::shared_future<ModelHandle> shell_load = shell_path ? assets.model_async(shell_path, loaders) : std::shared_future<ModelHandle>();
+	TextureLoad<Texture> shell_uv = shell_path ? load_texture(diffuse_map(shell_path), false) : TextureLoad<Texture>();
+	ModelHandle model = quantize ? ModelHandle() : assets.model(model_path);
+	CompactMeshHandle compact = quantize ? assets.compact_model(model_path) : CompactMeshHandle();
+	if (!model && !compact) return 1;
+	ModelHandle shell = wait_for(shell_load);
+	if (shell_path && !shell) return 1;
+	if (budget_ms>0) return render_progressive_still(model.get(), diffuse.get(), output_path, budget_ms);
+	return render_frames(model.get(), compact.get(), diffuse, normal_map, specular, ao, shell.get(), shell_uv, output_path, video_path, raw, mapped, frames);
+}
+
+int main(int argc, char** argv) {
+	// ./main ... --trace trace.json, in any mode: records stage timings and writes them out when main returns
+	trace_thread_name("main");
+	std::unique_ptr<TraceSession> trace;
+	for (int i=1; i+1<argc; i++) {
+		if (strcmp(argv[i], "--trace")) continue;
+		trace.reset(new TraceSession(argv[i+1]));
+		for (int k=i; k+2<=argc; k++) argv[k] = argv[k+2];
+		argc -= 2;
+		break;
+	}
+
+	// ./main --serve [socket_path] [--workers n] [--cache-mb n]
+	if (argc >= 2 && !strcmp(argv[1], "--serve")) {
+		const char *socket_path = NULL;
+		int workers = 0;
+		size_t cache_budget = ASSET_BUDGET;
+		for (int i=2; i<argc; i++) {
+			if (!strcmp(argv[i], "--workers") && i+1<argc) workers = atoi(argv[++i]);
+			else if (!strcmp(argv[i], "--cache-mb") && i+1<argc) cache_budget = (size_t)atol(argv[++i])<<20;
+			else socket_path = argv[i];
+		}
+		return socket_path ? serve_socket(socket_path, workers, cache_budget) : serve_stdin(workers, cache_budget);
+	}
+
+	// ./main --farm n [--tile px] [--timeout ms] [key=value ...], the keys are the server's
+	if (argc >= 3 && !strcmp(argv[1], "--farm")) {
+		int nworkers = atoi(argv[2]);
+		int tile = FARM_TILE;
+		double timeout_ms = FARM_TIMEOUT_MS;
+		std::string job = "output=output.tga";
+		for (int i=3; i<argc; i++) {
+			if (!strcmp(argv[i], "--tile") && i+1<argc) tile = atoi(argv[++i]);
+			else if (!strcmp(argv[i], "--timeout") && i+1<argc) timeout_ms = atof(argv[++i]);
+			else job += std::string(" ") + argv[i];
+		}
+		return render_farm(job, nworkers, tile, timeout_ms);
+	}
+
+	// ./main --regress [dir] [--record] [--threshold percent]
+	if (argc >= 2 && !strcmp(argv[1], "--regress")) {
+		const char *dir = "regress";
+		bool record = false;
+		float threshold = REGRESS_THRESHOLD;
+		for (int i=2; i<argc; i++) {
+			if (!strcmp(argv[i], "--record")) record = true;
+			else if (!strcmp(argv[i], "--threshold") && i+1<argc) threshold = atof(argv[++i])/100;
+			else dir = argv[i];
+		}
+		return run_regression(dir, record, threshold);
+	}
+
+	// ./main [model.obj] [diffuse.tga|qoi] [--output output.tga|qoi] [--compress] [--quantize] [--progressive ms] [--part model.obj[:diffuse.tga] ...] [--phong] [--nm map] [--spec map] [--ssao|--ssao-half] [--oit shell.obj] [--mapped] [--video path|-] [--raw] [--frames n] [--crowd n]
+	const char *model_path = "obj/african_head/african_head.obj";
+	const char *texture_path = "obj/african_head/african_head_diffuse.tga";
+	const char *output_path = "output.tga";
+	const char *video_path = NULL;
+	bool raw = false;
+	bool mapped = false;
+	bool compress = false;
+	bool quantize = false;
+	double budget_ms = 0;
+	std::vector<std::string> parts;
+	bool phong = false;
+	const char *nm_arg = NULL;
+	const char *spec_arg = NULL;
+	int ao = 0;
+	const char *shell_path = NULL;
+	int frames = 100;
+	int crowd = 0;
+	int npositional = 0;
+	for (int i=1; i<argc; i++) {
+		if (!strcmp(argv[i], "--output") && i+1<argc) output_path = argv[++i];
+		else if (!strcmp(argv[i], "--video") && i+1<argc) video_path = argv[++i];
+		else if (!strcmp(argv[i], "--raw")) raw = true;
+		else if (!strcmp(argv[i], "--mapped")) mapped = true;
+		else if (!strcmp(argv[i], "--compress")) compress = true;
+		else if (!strcmp(argv[i], "--quantize")) quantize = true;
+		else if (!strcmp(argv[i], "--progressive") && i+1<argc) budget_ms = atof(argv[++i]);
+		else if (!strcmp(argv[i], "--part") && i+1<argc) parts.push_back(argv[++i]);
+		else if (!strcmp(argv[i], "--phong")) phong = true;
+		else if (!strcmp(argv[i], "--nm") && i+1<argc) { nm_arg = argv[++i]; phong = true; }
+		else if (!strcmp(argv[i], "--spec") && i+1<argc) { spec_arg = argv[++i]; phong = true; }
+		else if (!strcmp(argv[i], "--ssao")) ao = 1;
+		else if (!strcmp(argv[i], "--ssao-half")) ao = 2;
+		else if (!strcmp(argv[i], "--oit") && i+1<argc) shell_path = argv[++i];
+		else if (!strcmp(argv[i], "--frames") && i+1<argc) frames = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "--crowd") && i+1<argc) crowd = atoi(argv[++i]);
+		else if (npositional++ == 0) model_path = argv[i];
+		else texture_path = argv[i];
+	}
+
+	// the cache also sorts the faces into meshlets and loads the texture bottom row first
+	AssetCache assets;
+	// --quantize keeps only the compact encoding of the model
+	if (quantize && phong) {
+		std::cerr << "can't shade --phong from a quantized mesh, it has no tangent frames" << std::endl;
+		return 1;
+	}
+	// --progressive is the plain textured still only
+	if (budget_ms>0 && (quantize || phong || ao || shell_path || video_path)) {
+		std::cerr << "can't combine --progressive with other passes or video" << std::endl;
+		return 1;
+	}
+	// --part draws more models next to the first, sort-last, the plain textured still only
+	if (!parts.empty()) {
+		if (quantize || budget_ms>0 || phong || ao || shell_path || video_path) {
+			std::cerr << "can't combine --part with other passes or video" << std::endl;
+			return 1;
+		}
+		std::vector<std::string> models(1, model_path), textures(1, texture_path);
+		for (size_t i=0; i<parts.size(); i++) {
+			// model.obj:diffuse.tga, or the model's own _diffuse.tga
+			size_t colon = parts[i].rfind(':');
+			models.push_back(colon==std::string::npos ? parts[i] : parts[i].substr(0, colon));
+			textures.push_back(colon==std::string::npos ? diffuse_map(parts[i]) : parts[i].substr(colon+1));
+		}
+		if (compress) return render_parts_still<BCTexture>(models, textures, [&](const std::string& p) { return assets.compressed_texture(p); }, assets, output_path);
+		return render_parts_still<TGAImage>(models, textures, [&](const std::string& p) { return assets.texture(p); }, assets, output_path);
+	}
+	// --crowd draws many copies through the model's level of detail chain, plain textured only
+	if (crowd>0) {
+		if (quantize || budget_ms>0 || phong || ao || shell_path || mapped) {
+			std::cerr << "can't combine --crowd with other passes" << std::endl;
+			return 1;
+		}
+		if (compress) return render_crowd(model_path, assets.compressed_texture(texture_path).get(), crowd, output_path, video_path, raw, frames);
+		return render_crowd(model_path, assets.texture(texture_path).get(), crowd, output_path, video_path, raw, frames);
+	}
+	// --phong takes the tangent space normal map and specular map next to the diffuse one, unless they're named
+	std::string nm_path = nm_arg ? nm_arg : phong ? sibling_map(texture_path, "_nm_tangent") : "";
+	std::string spec_path = spec_arg ? spec_arg : phong ? sibling_map(texture_path, "_spec") : "";
+	if (phong && nm_path.empty() && spec_path.empty()) {
+		std::cerr << "can't find a _nm_tangent or _spec map next to " << texture_path << ", name them with --nm and --spec" << std::endl;
+		return 1;
+	}
+	// after the cache, so the loads still queued finish before it goes
+	ThreadPool loaders(ASSET_LOADERS);
+	TextureLoader<BCTexture> load_compressed = [&](const std::string& path, bool normal_map) { return assets.compressed_texture_async(path, loaders, normal_map); };
+	TextureLoader<TGAImage> load_plain = [&](const std::string& path, bool) { return assets.texture_async(path, loaders); };
+	if (compress) return render_still<BCTexture>(assets, loaders, load_compressed, model_path, texture_path, quantize, nm_path, spec_path, ao, shell_path, budget_ms,
+		output_path, video_path, raw, mapped, frames);
+	return render_still<TGAImage>(assets, loaders, load_plain, model_path, texture_path, quantize, nm_path, spec_path, ao, shell_path, budget_ms,
+		output_path, video_path, raw, mapped, frames);
+}
+
+
+
@@ -0,0 +1,79 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <iostream>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "tgaimage.h"
+#include "mappedtga.h"
+
+// what write_tga_file puts after the pixels: no developer or extension area, then the signature
+static const unsigned char footer[26] = {0,0,0,0, 0,0,0,0, 'T','R','U','E','V','I','S','I','O','N','-','X','F','I','L','E','.','\0'};
+
+MappedTGA::MappedTGA(const char *filename, int width, int height, int bytespp) : fd(-1), base(NULL), length(0) {
+	if (width<=0 || height<=0 || width>0xffff || height>0xffff || (bytespp!=TGAImage::GRAYSCALE && bytespp!=TGAImage::RGB && bytespp!=TGAImage::RGBA)) {
+		std::cerr << "can't map a " << width << "x" << height << "x" << bytespp << " tga\n";
+		return;
+	}
+	size_t data = (size_t)width*height*bytespp;
+	length = sizeof(TGA_Header)+data+sizeof(footer);
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd<0) {
+		std::cerr << "can't open file " << filename << "\n";
+		return;
+	}
+	// reserve the blocks now, a full disk is an error here rather than a SIGBUS halfway through a frame
+	if (ftruncate(fd, length)!=0 || posix_fallocate(fd, 0, length)!=0) {
+		std::cerr << "can't allocate " << length << " bytes for " << filename << "\n";
+		::close(fd);
+		fd = -1;
+		unlink(filename);
+		return;
+	}
+	void* p = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (p==MAP_FAILED) {
+		std::cerr << "can't map " << filename << "\n";
+		::close(fd);
+		fd = -1;
+		unlink(filename);
+		return;
+	}
+	base = (unsigned char*)p;
+	TGA_Header header;
+	memset((void *)&header, 0, sizeof(header));
+	header.bitsperpixel = bytespp<<3;
+	header.width  = width;
+	header.height = height;
+	header.datatypecode = bytespp==TGAImage::GRAYSCALE ? 3 : 2;
+	header.imagedescriptor = 0x00; // bottom-left origin
+	memcpy(base, &header, sizeof(header));
+	memcpy(base+sizeof(header)+data, footer, sizeof(footer));
+	// the pixels start right after the 18 byte header, which is fine for byte access
+	pixels = ImageView(base+sizeof(header), width, height, bytespp, (ptrdiff_t)width*bytespp);
+}
+
+MappedTGA::~MappedTGA() {
+	close();
+}
+
+bool MappedTGA::sync() {
+	if (!base) return false;
+	if (msync(base, length, MS_SYNC)!=0) {
+		std::cerr << "can't sync the mapped tga\n";
+		return false;
+	}
+	return true;
+}
+
+bool MappedTGA::close() {
+	if (!base) return false;
+	bool ok = munmap(base, length)==0;
+	ok = ::close(fd)==0 && ok;
+	base = NULL;
+	fd = -1;
+	pixels = ImageView();
+	if (!ok) std::cerr << "can't unmap the tga file\n";
+	return ok;
+}
@@ -0,0 +1,32 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_MAPPEDTGA_H
+#define TATE_MAPPEDTGA_H
+
+#include <cstddef>
+#include "imageview.h"
+
+// an uncompressed tga that is its own framebuffer. the file is created at full size with the header and
+// footer already in place, and the pixel region is mapped shared, so whatever is drawn into view() lands in
+// the file's pages: there is no buffer to copy out and nothing held besides the page cache. rows are stored
+// bottom first, the same way the rasterizer fills them, and the header says so. close() unmaps, sync()
+// waits for the pages to reach the disk first
+class MappedTGA {
+public:
+	MappedTGA(const char *filename, int width, int height, int bytespp);
+	MappedTGA(const MappedTGA&) = delete;
+	MappedTGA& operator=(const MappedTGA&) = delete;
+	~MappedTGA();
+	bool good() const { return base!=NULL; }
+	const ImageView& view() const { return pixels; }
+	bool sync();
+	bool close();
+private:
+	int fd;
+	unsigned char* base; // the whole file
+	size_t length;
+	ImageView pixels;
+};
+
+#endif // TATE_MAPPEDTGA_H
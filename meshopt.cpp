@@ -0,0 +1,237 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cmath>
+#include <limits>
+#include "geometry.h"
+#include "model.h"
+#include "trace.h"
+#include "meshopt.h"
+
+// spread the low 10 bits of v out so there are two zero bits between each of them
+static unsigned int expand_bits(unsigned int v) {
+	v = (v * 0x00010001u) & 0xFF0000FFu;
+	v = (v * 0x00000101u) & 0x0F00F00Fu;
+	v = (v * 0x00000011u) & 0xC30C30C3u;
+	v = (v * 0x00000005u) & 0x49249249u;
+	return v;
+}
+
+// 30 bit morton code of a point with coords in [0,1]
+unsigned int morton3(Vec3f p) {
+	unsigned int code = 0;
+	for (int i=0; i<3; i++) {
+		float c = std::min(std::max(p.raw[i]*1024.f, 0.f), 1023.f);
+		code |= expand_bits((unsigned int)c) << (2-i);
+	}
+	return code;
+}
+
+// score of a vertex from its position in the cache and how many faces still use it (Tom Forsyth, 2006)
+static float vertex_score(int cache_pos, int remaining) {
+	if (remaining==0) return -1;
+	float score = 0;
+	if (cache_pos>=0) {
+		// the last face's vertices get a fixed score so we don't favour one of them
+		if (cache_pos<3) score = 0.75f;
+		else score = std::pow(1.f - (cache_pos-3)/(float)(VCACHE_SIZE-3), 1.5f);
+	}
+	// bonus for vertices with few faces left, so we finish them off instead of leaving stragglers
+	score += 2.f/std::sqrt((float)remaining);
+	return score;
+}
+
+// appends the faces [first_face, first_face+nfaces) to order, in an order that reuses the vertex cache
+void forsyth_order(const Model* model, int first_face, int nfaces, std::vector<int>& order) {
+	// give the vertices of this range local ids
+	std::unordered_map<int, int> local;
+	std::vector<int> fverts(nfaces*3);
+	for (int i=0; i<nfaces; i++) {
+		std::vector<Vec3i> f = model->face(first_face+i);
+		for (int j=0; j<3; j++) {
+			std::unordered_map<int, int>::iterator it = local.find(f[j].ivert);
+			if (it==local.end()) it = local.insert(std::make_pair(f[j].ivert, (int)local.size())).first;
+			fverts[i*3+j] = it->second;
+		}
+	}
+	int nv = (int)local.size();
+	std::vector<int> remaining(nv, 0);
+	std::vector<int> cache_pos(nv, -1);
+	std::vector<float> vscore(nv);
+	std::vector<std::vector<int>> vfaces(nv);
+	for (int i=0; i<nfaces*3; i++) {
+		remaining[fverts[i]]++;
+		vfaces[fverts[i]].push_back(i/3);
+	}
+	for (int v=0; v<nv; v++) vscore[v] = vertex_score(-1, remaining[v]);
+	std::vector<float> fscore(nfaces);
+	std::vector<bool> emitted(nfaces, false);
+	for (int i=0; i<nfaces; i++) {
+		fscore[i] = vscore[fverts[i*3]] + vscore[fverts[i*3+1]] + vscore[fverts[i*3+2]];
+	}
+
+	std::vector<int> cache;
+	int best = -1;
+	for (int n=0; n<nfaces; n++) {
+		// nothing in the cache is useful any more, fall back on the best face overall
+		if (best<0) {
+			float best_score = -1;
+			for (int i=0; i<nfaces; i++) {
+				if (!emitted[i] && fscore[i]>best_score) { best_score = fscore[i]; best = i; }
+			}
+		}
+		emitted[best] = true;
+		order.push_back(first_face+best);
+
+		// move the face's vertices to the front of the cache
+		std::vector<int> new_cache;
+		for (int j=0; j<3; j++) {
+			int v = fverts[best*3+j];
+			new_cache.push_back(v);
+			remaining[v]--;
+			std::vector<int>& vf = vfaces[v];
+			vf.erase(std::find(vf.begin(), vf.end(), best));
+		}
+		for (size_t k=0; k<cache.size(); k++) {
+			int v = cache[k];
+			if (v!=new_cache[0] && v!=new_cache[1] && v!=new_cache[2]) new_cache.push_back(v);
+		}
+		// vertices pushed out of the cache lose their cache score
+		for (size_t k=VCACHE_SIZE; k<new_cache.size(); k++) cache_pos[new_cache[k]] = -1;
+		if ((int)new_cache.size()>VCACHE_SIZE) new_cache.resize(VCACHE_SIZE);
+		cache.swap(new_cache);
+
+		// rescore the cached vertices and pick the best face touching them
+		for (size_t k=0; k<cache.size(); k++) {
+			cache_pos[cache[k]] = (int)k;
+			vscore[cache[k]] = vertex_score((int)k, remaining[cache[k]]);
+		}
+		best = -1;
+		float best_score = -1;
+		for (size_t k=0; k<cache.size(); k++) {
+			std::vector<int>& vf = vfaces[cache[k]];
+			for (size_t m=0; m<vf.size(); m++) {
+				int i = vf[m];
+				fscore[i] = vscore[fverts[i*3]] + vscore[fverts[i*3+1]] + vscore[fverts[i*3+2]];
+				if (fscore[i]>best_score) { best_score = fscore[i]; best = i; }
+			}
+		}
+	}
+}
+
+// fills in the bounding sphere, box and normal cone of a meshlet from its faces
+void meshlet_bounds(const Model* model, Meshlet& m) {
+	Vec3f sum;
+	m.bmin = Vec3f(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+	m.bmax = Vec3f()-m.bmin;
+	std::vector<Vec3f> normals;
+	for (int i=m.first_face; i<m.first_face+m.nfaces; i++) {
+		std::vector<Vec3i> f = model->face(i);
+		Vec3f p[3];
+		for (int j=0; j<3; j++) {
+			p[j] = model->vert(f[j].ivert);
+			sum = sum + p[j];
+			for (int a=0; a<3; a++) {
+				m.bmin.raw[a] = std::min(m.bmin.raw[a], p[j].raw[a]);
+				m.bmax.raw[a] = std::max(m.bmax.raw[a], p[j].raw[a]);
+			}
+		}
+		Vec3f n = (p[1]-p[0])^(p[2]-p[0]);
+		if (n.norm()>0) normals.push_back(n.normalize());
+	}
+	m.center = sum * (1.f/(3*m.nfaces));
+	m.radius = 0;
+	for (int i=m.first_face; i<m.first_face+m.nfaces; i++) {
+		std::vector<Vec3i> f = model->face(i);
+		for (int j=0; j<3; j++) m.radius = std::max(m.radius, (model->vert(f[j].ivert)-m.center).norm());
+	}
+
+	// cone around the average normal. a cutoff of -1 means the cone can't cull anything
+	Vec3f axis;
+	for (size_t k=0; k<normals.size(); k++) axis = axis + normals[k];
+	m.cone_axis = Vec3f(0, 0, 1);
+	m.cone_cutoff = -1;
+	if (axis.norm()<1e-6) return;
+	m.cone_axis = axis.normalize();
+	m.cone_cutoff = 1;
+	for (size_t k=0; k<normals.size(); k++) m.cone_cutoff = std::min(m.cone_cutoff, normals[k]*m.cone_axis);
+}
+
+// sorts the faces along a morton curve, cuts them into meshlets of MESHLET_SIZE faces
+// and vertex cache optimizes the faces inside each meshlet
+void build_meshlets(Model* model) {
+	int nfaces = model->nfaces();
+	Vec3f extent = model->max - model->min;
+	for (int i=0; i<3; i++) if (extent.raw[i]<=0) extent.raw[i] = 1;
+
+	std::vector<std::pair<unsigned int, int>> keys(nfaces);
+	for (int i=0; i<nfaces; i++) {
+		std::vector<Vec3i> f = model->face(i);
+		Vec3f c = (model->vert(f[0].ivert) + model->vert(f[1].ivert) + model->vert(f[2].ivert)) * (1.f/3);
+		for (int j=0; j<3; j++) c.raw[j] = (c.raw[j]-model->min.raw[j])/extent.raw[j];
+		keys[i] = std::make_pair(morton3(c), i);
+	}
+	std::sort(keys.begin(), keys.end());
+	std::vector<int> order(nfaces);
+	for (int i=0; i<nfaces; i++) order[i] = keys[i].second;
+	model->reorder_faces(order);
+
+	order.clear();
+	std::vector<Meshlet> meshlets;
+	for (int first=0; first<nfaces; first+=MESHLET_SIZE) {
+		Meshlet m;
+		m.first_face = first;
+		m.nfaces = std::min(MESHLET_SIZE, nfaces-first);
+		forsyth_order(model, m.first_face, m.nfaces, order);
+		meshlets.push_back(m);
+	}
+	model->reorder_faces(order);
+
+	for (size_t k=0; k<meshlets.size(); k++) {
+		meshlet_bounds(model, meshlets[k]);
+	}
+	model->set_meshlets(meshlets);
+}
+
+// load time optimization pass, prints the average cache miss ratio before and after
+void optimize_mesh(Model* model) {
+	TRACE_SCOPE("build meshlets");
+	if (model->nfaces()==0) return;
+	float before = acmr(model);
+	build_meshlets(model);
+	std::cerr << "# meshlets " << model->nmeshlets() << " acmr " << before << " -> " << acmr(model) << std::endl;
+}
+
+// meshlet indices sorted roughly front to back (by distance of their centers to the camera)
+std::vector<int> meshlet_order(const Model* model, Vec3f camera_pos) {
+	int n = model->nmeshlets();
+	std::vector<std::pair<float, int>> keys(n);
+	for (int i=0; i<n; i++) {
+		Vec3f d = model->meshlet(i).center - camera_pos;
+		keys[i] = std::make_pair(d*d, i);
+	}
+	std::sort(keys.begin(), keys.end());
+	std::vector<int> order(n);
+	for (int i=0; i<n; i++) order[i] = keys[i].second;
+	return order;
+}
+
+// average cache miss ratio: vertex transforms per face with a fifo cache of VCACHE_SIZE
+float acmr(const Model* model) {
+	std::vector<int> stamp(model->nverts(), -VCACHE_SIZE-1);
+	int misses = 0;
+	for (int i=0; i<model->nfaces(); i++) {
+		std::vector<Vec3i> f = model->face(i);
+		for (int j=0; j<3; j++) {
+			if (misses-stamp[f[j].ivert] > VCACHE_SIZE) {
+				stamp[f[j].ivert] = misses;
+				misses++;
+			}
+		}
+	}
+	return model->nfaces() ? misses/(float)model->nfaces() : 0;
+}
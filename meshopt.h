@@ -0,0 +1,22 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_MESHOPT_H
+#define TATE_MESHOPT_H
+
+#include <vector>
+#include "geometry.h"
+#include "model.h"
+
+const int MESHLET_SIZE = 32;  // faces per meshlet
+const int VCACHE_SIZE  = 32;  // simulated post-transform cache size for forsyth
+
+unsigned int morton3(Vec3f p);
+void forsyth_order(const Model* model, int first_face, int nfaces, std::vector<int>& order);
+void meshlet_bounds(const Model* model, Meshlet& m);
+void build_meshlets(Model* model);
+void optimize_mesh(Model* model);
+std::vector<int> meshlet_order(const Model* model, Vec3f camera_pos);
+float acmr(const Model* model);
+
+#endif // TATE_MESHOPT_H
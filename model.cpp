@@ -6,9 +6,14 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <map>
+#include <cmath>
+#include <algorithm>
 #include "model.h"
+#include "trace.h"
 
-Model::Model(const char *filename) : verts_(), texture_verts_(), normal_verts_(), faces_(), min(), max() {
+Model::Model(const char *filename) : verts_(), texture_verts_(), normal_verts_(), faces_(), meshlets_(), bvh_(), min(), max() {
+    TRACE_SCOPE("load obj");
     for (int i=0; i<3; i++) {
         min.raw[i] = std::numeric_limits<float>::max();
         max.raw[i] = std::numeric_limits<float>::lowest();
@@ -53,39 +58,276 @@ Model::Model(const char *filename) : verts_(), texture_verts_(), normal_verts_()
         }
     }
     std::cerr << "# v# " << verts_.size() << " f# "  << faces_.size() << std::endl;
+    compute_tangent_frames();
+    compute_face_data();
+}
+
+Model::Model(const std::vector<Vec3f>& verts, const std::vector<Vec2f>& texture_verts, const std::vector<Vec3f>& normal_verts, const std::vector<std::vector<Vec3i>>& faces)
+    : verts_(verts), texture_verts_(texture_verts), normal_verts_(normal_verts), faces_(faces), meshlets_(), bvh_(), min(), max() {
+    for (int i=0; i<3; i++) {
+        min.raw[i] = std::numeric_limits<float>::max();
+        max.raw[i] = std::numeric_limits<float>::lowest();
+    }
+    for (size_t k=0; k<verts_.size(); k++) {
+        for (int i=0; i<3; i++) {
+            if (verts_[k].raw[i] < min.raw[i]) min.raw[i] = verts_[k].raw[i];
+            if (verts_[k].raw[i] > max.raw[i]) max.raw[i] = verts_[k].raw[i];
+        }
+    }
+    compute_tangent_frames();
+    compute_face_data();
 }
 
 Model::~Model() {
 }
 
-int Model::nverts() {
+// fills the per face arrays so the renderer doesn't redo the cross products every frame
+void Model::compute_face_data() {
+    size_t n = faces_.size();
+    for (int c=0; c<3; c++) {
+        face_normal_[c].assign(n, 0);
+        face_bmin_[c].assign(n, 0);
+        face_bmax_[c].assign(n, 0);
+    }
+    face_offset_.assign(n, 0);
+    face_area_.assign(n, 0);
+    for (size_t i=0; i<n; i++) {
+        const std::vector<Vec3i>& f = faces_[i];
+        if (f.size()<3) continue;
+        Vec3f p[3];
+        for (int j=0; j<3; j++) p[j] = verts_[f[j].ivert];
+        Vec3f normal = (p[1]-p[0])^(p[2]-p[0]);
+        float area = normal.norm()*.5f;
+        if (area>0) normal.normalize();
+        for (int c=0; c<3; c++) {
+            face_normal_[c][i] = normal.raw[c];
+            face_bmin_[c][i] = std::min(p[0].raw[c], std::min(p[1].raw[c], p[2].raw[c]));
+            face_bmax_[c][i] = std::max(p[0].raw[c], std::max(p[1].raw[c], p[2].raw[c]));
+        }
+        face_offset_[i] = normal*p[0];
+        face_area_[i] = area;
+    }
+}
+
+// builds an orthonormal tangent/bitangent/normal frame for every (vert, uv) pair so tangent space
+// normal maps can be shaded without working out the basis per pixel. tangents are summed over the
+// faces around the vertex, the normal comes from the obj's vn (or the face normals if it has none)
+void Model::compute_tangent_frames() {
+    std::map<std::pair<int,int>, int> ids;
+    std::vector<Vec3f> t, b, n;
+    corner_frames_.assign(faces_.size()*3, 0);
+    for (size_t i=0; i<faces_.size(); i++) {
+        const std::vector<Vec3i>& f = faces_[i];
+        if (f.size()<3) continue;
+        // undo the loader's uv swap so that corner j really has uv[j]
+        int iuv[3] = {f[0].iuv, f[2].iuv, f[1].iuv};
+        Vec3f p[3];
+        Vec2f uv[3];
+        for (int j=0; j<3; j++) {
+            p[j] = verts_[f[j].ivert];
+            uv[j] = iuv[j]>=0 && iuv[j]<(int)texture_verts_.size() ? texture_verts_[iuv[j]] : Vec2f();
+        }
+        Vec3f e1 = p[1]-p[0], e2 = p[2]-p[0];
+        float du1 = uv[1].u-uv[0].u, dv1 = uv[1].v-uv[0].v;
+        float du2 = uv[2].u-uv[0].u, dv2 = uv[2].v-uv[0].v;
+        float det = du1*dv2-du2*dv1;
+        Vec3f ft, fb;
+        if (std::abs(det)>1e-12f) {
+            float r = 1.f/det;
+            ft = (e1*dv2-e2*dv1)*r;
+            fb = (e2*du1-e1*du2)*r;
+        }
+        Vec3f fn = e1^e2; // area weighted
+        for (int j=0; j<3; j++) {
+            std::pair<std::map<std::pair<int,int>, int>::iterator, bool> it = ids.insert(std::make_pair(std::make_pair(f[j].ivert, iuv[j]), (int)t.size()));
+            if (it.second) {
+                t.push_back(Vec3f());
+                b.push_back(Vec3f());
+                n.push_back(Vec3f());
+            }
+            int k = it.first->second;
+            corner_frames_[i*3+j] = k;
+            t[k] = t[k]+ft;
+            b[k] = b[k]+fb;
+            int inorm = f[j].inorm;
+            n[k] = n[k] + (inorm>=0 && inorm<(int)normal_verts_.size() ? normal_verts_[inorm] : fn);
+        }
+    }
+    for (int c=0; c<3; c++) {
+        tangent_[c].resize(t.size());
+        bitangent_[c].resize(t.size());
+        frame_normal_[c].resize(t.size());
+    }
+    for (size_t k=0; k<t.size(); k++) {
+        Vec3f nk = n[k];
+        if (nk.norm()<1e-12f) nk = Vec3f(0, 0, 1);
+        nk.normalize();
+        // gram-schmidt, and fall back to any perpendicular where the uvs were degenerate
+        Vec3f tk = t[k] - nk*(nk*t[k]);
+        if (tk.norm()<1e-12f) tk = std::abs(nk.x)<.9f ? Vec3f(1, 0, 0)-nk*nk.x : Vec3f(0, 1, 0)-nk*nk.y;
+        tk.normalize();
+        Vec3f bk = nk^tk;
+        if (bk*b[k]<0) bk = bk*-1.f; // mirrored uvs
+        for (int c=0; c<3; c++) {
+            tangent_[c][k] = tk.raw[c];
+            bitangent_[c][k] = bk.raw[c];
+            frame_normal_[c][k] = nk.raw[c];
+        }
+    }
+}
+
+// writes the model back out as wavefront obj, so that loading it again gives the same model
+bool Model::write_obj(const char *filename, const std::string& comment) const {
+    std::ofstream out;
+    out.open(filename, std::ofstream::out);
+    if (out.fail()) {
+        std::cerr << "can't open file " << filename << "\n";
+        return false;
+    }
+    out.precision(7);
+    if (!comment.empty()) out << "# " << comment << "\n";
+    for (size_t i=0; i<verts_.size(); i++) {
+        out << "v " << verts_[i].x << " " << verts_[i].y << " " << verts_[i].z << "\n";
+    }
+    for (size_t i=0; i<texture_verts_.size(); i++) {
+        out << "vt  " << texture_verts_[i].u << " " << texture_verts_[i].v << " 0\n";
+    }
+    for (size_t i=0; i<normal_verts_.size(); i++) {
+        out << "vn  " << normal_verts_[i].x << " " << normal_verts_[i].y << " " << normal_verts_[i].z << "\n";
+    }
+    for (size_t i=0; i<faces_.size(); i++) {
+        std::vector<Vec3i> f = faces_[i];
+        std::swap(f[1].iuv, f[2].iuv); // undo the swap done when loading
+        out << "f";
+        for (size_t j=0; j<f.size(); j++) {
+            out << " " << f[j].ivert+1 << "/" << f[j].iuv+1 << "/" << f[j].inorm+1;
+        }
+        out << "\n";
+    }
+    out.close();
+    return !out.fail();
+}
+
+int Model::nverts() const {
     return (int)verts_.size();
 }
 
-int Model::ntexture_verts() {
+int Model::ntexture_verts() const {
     return (int)texture_verts_.size();
 }
 
-int Model::nnormal_verts() {
+int Model::nnormal_verts() const {
     return (int)normal_verts_.size();
 }
 
-int Model::nfaces() {
+int Model::nfaces() const {
     return (int)faces_.size();
 }
 
-Vec3f Model::vert(int i) {
+int Model::nmeshlets() const {
+    return (int)meshlets_.size();
+}
+
+int Model::nbvh_nodes() const {
+    return (int)bvh_.size();
+}
+
+int Model::nframes() const {
+    return (int)tangent_[0].size();
+}
+
+Vec3f Model::vert(int i) const {
     return verts_[i];
 }
 
-Vec2f Model::texture_vert(int i) {
+Vec2f Model::texture_vert(int i) const {
     return texture_verts_[i];
 }
 
-Vec3f Model::normal_vert(int i) {
+Vec3f Model::normal_vert(int i) const {
     return normal_verts_[i];
 }
 
-std::vector<Vec3i> Model::face(int idx) {
+const std::vector<Vec3i>& Model::face(int idx) const {
     return faces_[idx];
 }
+
+Vec3f Model::tangent(int i) const {
+    return Vec3f(tangent_[0][i], tangent_[1][i], tangent_[2][i]);
+}
+
+Vec3f Model::bitangent(int i) const {
+    return Vec3f(bitangent_[0][i], bitangent_[1][i], bitangent_[2][i]);
+}
+
+Vec3f Model::frame_normal(int i) const {
+    return Vec3f(frame_normal_[0][i], frame_normal_[1][i], frame_normal_[2][i]);
+}
+
+int Model::corner_frame(int idx, int j) const {
+    return corner_frames_[idx*3+j];
+}
+
+const float* Model::face_normals(int c) const {
+    return face_normal_[c].data();
+}
+
+const float* Model::face_offsets() const {
+    return face_offset_.data();
+}
+
+const float* Model::face_areas() const {
+    return face_area_.data();
+}
+
+const float* Model::face_bmin(int c) const {
+    return face_bmin_[c].data();
+}
+
+const float* Model::face_bmax(int c) const {
+    return face_bmax_[c].data();
+}
+
+// rough heap footprint of the model's data
+size_t Model::bytes() const {
+    size_t n = sizeof(Model);
+    n += verts_.capacity()*sizeof(Vec3f) + texture_verts_.capacity()*sizeof(Vec2f) + normal_verts_.capacity()*sizeof(Vec3f);
+    n += faces_.capacity()*sizeof(std::vector<Vec3i>);
+    for (size_t i=0; i<faces_.size(); i++) n += faces_[i].capacity()*sizeof(Vec3i);
+    n += meshlets_.capacity()*sizeof(Meshlet) + bvh_.capacity()*sizeof(BVHNode);
+    n += 3*(tangent_[0].capacity()+bitangent_[0].capacity()+frame_normal_[0].capacity())*sizeof(float);
+    n += corner_frames_.capacity()*sizeof(int);
+    n += (3*(face_normal_[0].capacity()+face_bmin_[0].capacity()+face_bmax_[0].capacity())+face_offset_.capacity()+face_area_.capacity())*sizeof(float);
+    return n;
+}
+
+Meshlet Model::meshlet(int idx) const {
+    return meshlets_[idx];
+}
+
+void Model::reorder_faces(const std::vector<int>& order) {
+    std::vector<std::vector<Vec3i>> faces(order.size());
+    std::vector<int> corner_frames(order.size()*3);
+    for (size_t i=0; i<order.size(); i++) {
+        faces[i] = faces_[order[i]];
+        for (int j=0; j<3; j++) corner_frames[i*3+j] = corner_frames_[order[i]*3+j];
+    }
+    faces_.swap(faces);
+    corner_frames_.swap(corner_frames);
+    compute_face_data();
+    meshlets_.clear();
+    bvh_.clear();
+}
+
+BVHNode Model::bvh_node(int idx) const {
+    return bvh_[idx];
+}
+
+void Model::set_meshlets(const std::vector<Meshlet>& meshlets) {
+    meshlets_ = meshlets;
+    bvh_.clear();
+}
+
+void Model::set_bvh(const std::vector<BVHNode>& nodes) {
+    bvh_ = nodes;
+}
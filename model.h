@@ -2,25 +2,84 @@
 #define __MODEL_H__
 
 #include <vector>
+#include <string>
 #include "geometry.h"
 
+// a run of consecutive faces that are close together in space
+struct Meshlet {
+	int first_face;
+	int nfaces;
+	Vec3f center;      // bounding sphere
+	float radius;
+	Vec3f bmin, bmax;  // bounding box
+	Vec3f cone_axis;   // every face normal is within acos(cone_cutoff) of cone_axis
+	float cone_cutoff;
+};
+
+// node of the bounding volume hierarchy over the meshlets. node 0 is the root
+struct BVHNode {
+	Vec3f bmin, bmax;
+	int left, right;   // child nodes, -1 for leaves
+	int first_meshlet;
+	int nmeshlets;
+};
+
 class Model {
 private:
 	std::vector<Vec3f> verts_;
 	std::vector<Vec2f> texture_verts_;
 	std::vector<Vec3f> normal_verts_;
 	std::vector<std::vector<Vec3i>> faces_;
+	std::vector<Meshlet> meshlets_;
+	std::vector<BVHNode> bvh_;
+	// tangent frames, one per distinct (vert, uv) pair, stored as separate x/y/z arrays
+	std::vector<float> tangent_[3];
+	std::vector<float> bitangent_[3];
+	std::vector<float> frame_normal_[3];
+	std::vector<int> corner_frames_; // 3 per face, see corner_frame()
+	// per face unit normal, plane offset (normal*vert), area and bounding box, again split by axis
+	std::vector<float> face_normal_[3];
+	std::vector<float> face_offset_;
+	std::vector<float> face_area_;
+	std::vector<float> face_bmin_[3];
+	std::vector<float> face_bmax_[3];
+	void compute_tangent_frames();
+	void compute_face_data();
 public:
 	Model(const char *filename);
+	Model(const std::vector<Vec3f>& verts, const std::vector<Vec2f>& texture_verts, const std::vector<Vec3f>& normal_verts, const std::vector<std::vector<Vec3i>>& faces);
 	~Model();
-	int nverts();
-	int ntexture_verts();
-	int nnormal_verts();
-	int nfaces();
-	Vec3f vert(int i);
-	Vec2f texture_vert(int i);
-	Vec3f normal_vert(int i);
-	std::vector<Vec3i> face(int idx);
+	bool write_obj(const char *filename, const std::string& comment="") const; // comment goes on a # line at the top
+	int nverts() const;
+	int ntexture_verts() const;
+	int nnormal_verts() const;
+	int nfaces() const;
+	int nmeshlets() const;
+	int nbvh_nodes() const;
+	int nframes() const;
+	size_t bytes() const;
+	Vec3f vert(int i) const;
+	Vec2f texture_vert(int i) const;
+	Vec3f normal_vert(int i) const;
+	const std::vector<Vec3i>& face(int idx) const;
+	Meshlet meshlet(int idx) const;
+	BVHNode bvh_node(int idx) const;
+	Vec3f tangent(int i) const;
+	Vec3f bitangent(int i) const;
+	Vec3f frame_normal(int i) const;
+	// frame of face idx at its j-th corner, the one at vert(face(idx)[j].ivert). careful, face(idx)[j].iuv
+	// is the uv of a different corner for j=1,2 (see the loader)
+	int corner_frame(int idx, int j) const;
+	// the per face arrays, nfaces() long. c is the axis
+	const float* face_normals(int c) const;
+	const float* face_offsets() const;
+	const float* face_areas() const;
+	const float* face_bmin(int c) const;
+	const float* face_bmax(int c) const;
+	// order[i] is the old index of the face that ends up at i. drops any meshlets and bvh
+	void reorder_faces(const std::vector<int>& order);
+	void set_meshlets(const std::vector<Meshlet>& meshlets);
+	void set_bvh(const std::vector<BVHNode>& nodes);
 	Vec3f min;
 	Vec3f max;
 };
@@ -0,0 +1,113 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <vector>
+#include <algorithm>
+#include "tgaimage.h"
+#include "imageview.h"
+#include "threadpool.h"
+#include "trace.h"
+#include "oit.h"
+
+const int OIT_BAND = 16; // rows per resolve task
+
+OITBuffer::OITBuffer(int width, int height) : OITBuffer(width, height, (size_t)width*height*OIT_FRAGMENTS_PER_PIXEL) {}
+
+OITBuffer::OITBuffer(int width, int height, size_t max_fragments) : w(width), h(height), heads((size_t)width*height, -1), arena(max_fragments), used(0), overflowed(0) {}
+
+void OITBuffer::clear() {
+	std::fill(heads.begin(), heads.end(), -1);
+	used = 0;
+	overflowed = 0;
+}
+
+size_t OITBuffer::bytes() const {
+	return heads.size()*sizeof(int) + arena.size()*sizeof(Fragment);
+}
+
+void OITBuffer::add(int x, int y, int z, const TGAColor& color) {
+	int& head = heads[x+(size_t)y*w];
+	if (used<arena.size()) {
+		Fragment& f = arena[used];
+		f.z = z;
+		f.next = head;
+		f.b = color.b;
+		f.g = color.g;
+		f.r = color.r;
+		f.a = color.a;
+		head = (int)used++;
+		return;
+	}
+	overflowed++;
+	if (head<0) return;
+	// full, fold it into the fragment closest in depth: the nearer of the two goes over the other
+	int best = head;
+	for (int i=arena[head].next; i>=0; i=arena[i].next) {
+		if (std::abs(arena[i].z-z) < std::abs(arena[best].z-z)) best = i;
+	}
+	Fragment& f = arena[best];
+	Fragment in = {z, -1, color.b, color.g, color.r, color.a};
+	const Fragment& near = in.z>f.z ? in : f;
+	const Fragment& far = in.z>f.z ? f : in;
+	int a = near.a*255 + far.a*(255-near.a);  // alpha out, times 255
+	if (a==0) return;
+	int fw = far.a*(255-near.a);
+	unsigned char b = (near.b*near.a*255 + far.b*fw + a/2)/a;
+	unsigned char g = (near.g*near.a*255 + far.g*fw + a/2)/a;
+	unsigned char r = (near.r*near.a*255 + far.r*fw + a/2)/a;
+	f.z = near.z;
+	f.b = b;
+	f.g = g;
+	f.r = r;
+	f.a = (a+127)/255;
+}
+
+void OITBuffer::resolve_rows(const ImageView& image, int y0, int y1) const {
+	int bpp = image.get_bytespp();
+	Fragment list[OIT_MAX_DEPTH];
+	for (int y=y0; y<y1; y++) {
+		for (int x=0; x<w; x++) {
+			int i = heads[x+(size_t)y*w];
+			if (i<0) continue;
+			// gather, keeping the nearest OIT_MAX_DEPTH if there are more
+			int n = 0;
+			for (; i>=0; i=arena[i].next) {
+				if (n<OIT_MAX_DEPTH) {
+					list[n++] = arena[i];
+					continue;
+				}
+				int farthest = 0;
+				for (int k=1; k<n; k++) if (list[k].z<list[farthest].z) farthest = k;
+				if (arena[i].z>list[farthest].z) list[farthest] = arena[i];
+			}
+			// insertion sort far to near, lists are short
+			for (int k=1; k<n; k++) {
+				Fragment f = list[k];
+				int j = k;
+				for (; j>0 && list[j-1].z>f.z; j--) list[j] = list[j-1];
+				list[j] = f;
+			}
+			unsigned char* p = image.pixel(x, y);
+			int b = p[0], g = bpp>=3 ? p[1] : p[0], r = bpp>=3 ? p[2] : p[0];
+			for (int k=0; k<n; k++) {
+				int a = list[k].a;
+				b = (list[k].b*a + b*(255-a) + 127)/255;
+				g = (list[k].g*a + g*(255-a) + 127)/255;
+				r = (list[k].r*a + r*(255-a) + 127)/255;
+			}
+			if (bpp>=3) {
+				p[0] = b;
+				p[1] = g;
+				p[2] = r;
+			} else {
+				p[0] = (r*77 + g*150 + b*29 + 128)>>8;
+			}
+		}
+	}
+}
+
+void OITBuffer::resolve(const ImageView& image, ThreadPool* pool) const {
+	TRACE_SCOPE("oit resolve");
+	if (image.get_width()!=w || image.get_height()!=h || !image.row(0)) return;
+	parallel_for(pool, h, OIT_BAND, [this, &image](int y0, int y1) { resolve_rows(image, y0, y1); });
+}
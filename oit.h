@@ -0,0 +1,50 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_OIT_H
+#define TATE_OIT_H
+
+#include <vector>
+#include "tgaimage.h"
+#include "imageview.h"
+
+class ThreadPool;
+
+const int OIT_FRAGMENTS_PER_PIXEL = 2; // default arena size for the width*height constructor
+const int OIT_MAX_DEPTH = 32;          // most fragments one pixel blends, the nearest are kept
+
+// translucent fragments for order independent transparency. each pixel has a singly linked list threaded
+// through one arena allocated up front, so adding a fragment is a bump of the arena index and never
+// touches the heap. the arena is a hard cap: once it's full a fragment is folded into the nearest one its
+// pixel already has, or dropped if the pixel has none, and overflow() counts them
+class OITBuffer {
+public:
+	OITBuffer(int width, int height);
+	OITBuffer(int width, int height, size_t max_fragments);
+	// forgets every fragment, keeps the arena
+	void clear();
+	// z is in zbuffer units, higher is nearer. color's alpha is the opacity
+	void add(int x, int y, int z, const TGAColor& color);
+	// sorts each pixel's fragments far to near and blends them over image, rows are spread over pool
+	void resolve(const ImageView& image, ThreadPool* pool=NULL) const;
+	int get_width() const { return w; }
+	int get_height() const { return h; }
+	size_t size() const { return used; }
+	size_t capacity() const { return arena.size(); }
+	long overflow() const { return overflowed; }
+	size_t bytes() const;
+private:
+	struct Fragment {
+		int z;
+		int next;          // index into arena, -1 ends the list
+		unsigned char b, g, r, a;
+	};
+	int w, h;
+	std::vector<int> heads; // per pixel, -1 for none
+	std::vector<Fragment> arena;
+	size_t used;
+	long overflowed;
+	void resolve_rows(const ImageView& image, int y0, int y1) const;
+};
+
+#endif // TATE_OIT_H
@@ -0,0 +1,75 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include "tgaimage.h"
+#include "bctexture.h"
+#include "progressive.h"
+
+typedef std::chrono::steady_clock Clock;
+
+// pixels in a pass are 4x the last one's, and shading a quarter of them is skipped
+const double PROGRESSIVE_GROWTH = 4;
+
+template <class Texture> int render_progressive(const Model* model, const Texture& model_uv, int width, int height, Vec3f light_source, Vec3f camera_pos,
+		double budget_ms, const ProgressiveCallback& deliver, RenderStats* stats) {
+	Clock::time_point start = Clock::now();
+	std::unique_ptr<TGAImage> prev, cur;
+	std::vector<int> zbuffer;
+	int step = PROGRESSIVE_FIRST_STEP;
+	for (;; step /= 2) {
+		Clock::time_point pass_start = Clock::now();
+		int w = (width+step-1)/step, h = (height+step-1)/step;
+		cur.reset(new TGAImage(w, h, TGAImage::RGB));
+		zbuffer.assign((size_t)w*h, std::numeric_limits<int>::min());
+		if (prev) {
+			// the last pass's samples are the even ones of this pass. copy them over and pin their depth to the
+			// nearest there is, so every fragment there fails the depth test before it's shaded
+			int pw = prev->get_width(), ph = prev->get_height(), bpp = cur->get_bytespp();
+			for (int y=0; y<ph; y++) {
+				const unsigned char* src = prev->buffer()+(size_t)y*pw*bpp;
+				unsigned char* dst = cur->buffer()+(size_t)2*y*w*bpp;
+				int* z = zbuffer.data()+(size_t)2*y*w;
+				for (int x=0; x<pw; x++) {
+					memcpy(dst+2*x*bpp, src+x*bpp, bpp);
+					z[2*x] = std::numeric_limits<int>::max();
+				}
+			}
+		}
+		// the full image's scale over step, so pixel (i, j) here lands on (i*step, j*step) there. depth keeps
+		// the full scale so the samples come out as they would in the full image
+		render_viewport(model, model_uv, *cur, zbuffer.data(), Instance(), light_source, camera_pos, Viewport((width/2)/(float)step, width/2), stats);
+		double pass_ms = std::chrono::duration<double, std::milli>(Clock::now()-pass_start).count();
+		if (!deliver(ConstImageView(*cur), step) || step==1) break;
+		double elapsed = std::chrono::duration<double, std::milli>(Clock::now()-start).count();
+		if (elapsed+pass_ms*PROGRESSIVE_GROWTH > budget_ms) break;
+		prev.swap(cur);
+	}
+	return step;
+}
+
+// widens each sample row once and copies it down the rest of its block
+void upscale_nearest(const ConstImageView& frame, int step, const ImageView& dst) {
+	int bpp = dst.get_bytespp(), w = dst.get_width();
+	if (frame.get_bytespp()!=bpp || frame.get_width()<=0 || frame.get_height()<=0) return;
+	for (int y=0; y<dst.get_height(); y+=step) {
+		const unsigned char* src = frame.row(std::min(y/step, frame.get_height()-1));
+		unsigned char* out = dst.row(y);
+		for (int x=0; x<w; x+=step) {
+			const unsigned char* s = src+std::min(x/step, frame.get_width()-1)*bpp;
+			int n = std::min(step, w-x);
+			for (int k=0; k<n; k++) memcpy(out+(x+k)*bpp, s, bpp);
+		}
+		for (int k=1; k<step && y+k<dst.get_height(); k++) memcpy(dst.row(y+k), out, (size_t)w*bpp);
+	}
+}
+
+#define INSTANTIATE_PROGRESSIVE(Texture) \
+	template int render_progressive<Texture>(const Model*, const Texture&, int, int, Vec3f, Vec3f, double, const ProgressiveCallback&, RenderStats*);
+INSTANTIATE_PROGRESSIVE(TGAImage)
+INSTANTIATE_PROGRESSIVE(BCTexture)
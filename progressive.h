@@ -0,0 +1,30 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_PROGRESSIVE_H
+#define TATE_PROGRESSIVE_H
+
+#include <functional>
+#include "geometry.h"
+#include "model.h"
+#include "imageview.h"
+#include "renderer.h"
+
+const int PROGRESSIVE_FIRST_STEP = 8; // the first pass renders every 8th pixel across and down
+
+// gets each pass as soon as it's drawn. frame holds every step-th pixel of the full image across and down,
+// so step 1 is the full image, origin at the bottom left like render() leaves it. the view is only good
+// during the call. return false to stop refining
+typedef std::function<bool(const ConstImageView& frame, int step)> ProgressiveCallback;
+
+// renders coarse to fine: a pass at step PROGRESSIVE_FIRST_STEP, then 4, 2 and 1. each pass keeps the
+// samples the one before it already drew and only shades the three quarters that are new. a pass isn't
+// started if the last one suggests it would run past budget_ms (counted from the call), the first always
+// runs. returns the step of the last pass delivered, 1 when the full image was reached
+template <class Texture> int render_progressive(const Model* model, const Texture& model_uv, int width, int height, Vec3f light_source, Vec3f camera_pos,
+	double budget_ms, const ProgressiveCallback& deliver, RenderStats* stats=NULL);
+
+// a pass blown up to the full image in dst, each sample filling its step x step block
+void upscale_nearest(const ConstImageView& frame, int step, const ImageView& dst);
+
+#endif // TATE_PROGRESSIVE_H
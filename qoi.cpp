@@ -0,0 +1,237 @@
+// Author: Tate Maguire
+// October 19, 2026
+//
+// QOI ("quite ok image format") reading and writing for TGAImage, see https://qoiformat.org/qoi-specification.pdf
+// pixels are stored top row first like TGAImage keeps them. grayscale images are written as rgb
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <string.h>
+#include <strings.h>
+#include "tgaimage.h"
+#include "trace.h"
+#include "imageview.h"
+
+const unsigned char QOI_OP_INDEX = 0x00;
+const unsigned char QOI_OP_DIFF  = 0x40;
+const unsigned char QOI_OP_LUMA  = 0x80;
+const unsigned char QOI_OP_RUN   = 0xc0;
+const unsigned char QOI_OP_RGB   = 0xfe;
+const unsigned char QOI_OP_RGBA  = 0xff;
+const unsigned char QOI_MASK_2   = 0xc0;
+const int QOI_HEADER_SIZE = 14;
+const unsigned char qoi_padding[8] = {0,0,0,0,0,0,0,1};
+
+union QOIPixel {
+	struct {
+		unsigned char r, g, b, a;
+	};
+	unsigned int v;
+};
+
+static inline int qoi_hash(QOIPixel p) {
+	return (p.r*3 + p.g*5 + p.b*7 + p.a*11) & 63;
+}
+
+static inline bool qoi_equal(QOIPixel p, QOIPixel q) {
+	return p.v==q.v;
+}
+
+static void put32(unsigned char *p, unsigned int v) {
+	p[0] = v>>24; p[1] = v>>16; p[2] = v>>8; p[3] = v;
+}
+
+static unsigned int get32(const unsigned char *p) {
+	return (p[0]<<24) | (p[1]<<16) | (p[2]<<8) | p[3];
+}
+
+bool write_qoi_file(const ConstImageView& view, const char *filename) {
+	TRACE_SCOPE("write qoi");
+	int width = view.get_width(), height = view.get_height(), bytespp = view.get_bytespp();
+	if (!view.row(0) || width<=0 || height<=0) return false;
+	int channels = bytespp==TGAImage::RGBA ? 4 : 3;
+	unsigned long npixels = (unsigned long)width*height;
+	// worst case every pixel is a full QOI_OP_RGBA
+	std::vector<unsigned char> buf(QOI_HEADER_SIZE + npixels*(channels+1) + sizeof(qoi_padding));
+	unsigned char *out = &buf[0];
+	memcpy(out, "qoif", 4);
+	put32(out+4, width);
+	put32(out+8, height);
+	out[12] = channels;
+	out[13] = 0; // srgb with linear alpha
+	out += QOI_HEADER_SIZE;
+
+	QOIPixel index[64];
+	memset(index, 0, sizeof(index));
+	QOIPixel prev;
+	prev.r = prev.g = prev.b = 0;
+	prev.a = 255;
+	int run = 0;
+	const unsigned char *p = NULL;
+	for (unsigned long i=0; i<npixels; i++, p+=bytespp) {
+		if (i%width==0) p = view.row(i/width);
+		QOIPixel px;
+		if (bytespp==TGAImage::GRAYSCALE) { px.r = px.g = px.b = p[0]; px.a = 255; }
+		else { px.b = p[0]; px.g = p[1]; px.r = p[2]; px.a = bytespp==TGAImage::RGBA ? p[3] : 255; }
+
+		if (qoi_equal(px, prev)) {
+			run++;
+			if (run==62 || i==npixels-1) {
+				*out++ = QOI_OP_RUN | (run-1);
+				run = 0;
+			}
+			continue;
+		}
+		if (run>0) {
+			*out++ = QOI_OP_RUN | (run-1);
+			run = 0;
+		}
+		int h = qoi_hash(px);
+		if (qoi_equal(index[h], px)) {
+			*out++ = QOI_OP_INDEX | h;
+		} else {
+			index[h] = px;
+			if (px.a==prev.a) {
+				signed char vr = px.r - prev.r;
+				signed char vg = px.g - prev.g;
+				signed char vb = px.b - prev.b;
+				signed char vg_r = vr - vg;
+				signed char vg_b = vb - vg;
+				if (vr>-3 && vr<2 && vg>-3 && vg<2 && vb>-3 && vb<2) {
+					*out++ = QOI_OP_DIFF | (vr+2)<<4 | (vg+2)<<2 | (vb+2);
+				} else if (vg_r>-9 && vg_r<8 && vg>-33 && vg<32 && vg_b>-9 && vg_b<8) {
+					*out++ = QOI_OP_LUMA | (vg+32);
+					*out++ = (vg_r+8)<<4 | (vg_b+8);
+				} else {
+					out[0] = QOI_OP_RGB; out[1] = px.r; out[2] = px.g; out[3] = px.b;
+					out += 4;
+				}
+			} else {
+				out[0] = QOI_OP_RGBA; out[1] = px.r; out[2] = px.g; out[3] = px.b; out[4] = px.a;
+				out += 5;
+			}
+		}
+		prev = px;
+	}
+	memcpy(out, qoi_padding, sizeof(qoi_padding));
+	out += sizeof(qoi_padding);
+
+	std::ofstream f;
+	f.open(filename, std::ios::binary);
+	if (!f.is_open()) {
+		std::cerr << "can't open file " << filename << "\n";
+		return false;
+	}
+	f.write((char *)&buf[0], out-&buf[0]);
+	if (!f.good()) {
+		std::cerr << "can't dump the qoi file\n";
+		return false;
+	}
+	return true;
+}
+
+bool TGAImage::write_qoi_file(const char *filename) {
+	if (!data) return false;
+	return ::write_qoi_file(ConstImageView(*this), filename);
+}
+
+// qoi is always stored top-down, bottom_up decodes it into the rows from the end
+bool TGAImage::read_qoi_file(const char *filename, bool bottom_up) {
+	TRACE_SCOPE("decode qoi");
+	if (data) delete [] data;
+	data = NULL;
+	std::ifstream f;
+	f.open(filename, std::ios::binary);
+	if (!f.is_open()) {
+		std::cerr << "can't open file " << filename << "\n";
+		return false;
+	}
+	f.seekg(0, std::ios::end);
+	std::vector<unsigned char> in((size_t)f.tellg());
+	f.seekg(0, std::ios::beg);
+	if (!in.empty()) f.read((char *)&in[0], in.size());
+	if (in.size()<QOI_HEADER_SIZE+sizeof(qoi_padding) || memcmp(&in[0], "qoif", 4)) {
+		std::cerr << "not a qoi file " << filename << "\n";
+		return false;
+	}
+	unsigned int w = get32(&in[4]);
+	unsigned int h = get32(&in[8]);
+	int channels = in[12];
+	if (w==0 || h==0 || w>32767 || h>32767 || (channels!=3 && channels!=4)) {
+		std::cerr << "bad qoi header in " << filename << "\n";
+		return false;
+	}
+	width = w;
+	height = h;
+	bytespp = channels==4 ? RGBA : RGB;
+	unsigned long npixels = (unsigned long)width*height;
+	data = new unsigned char[npixels*bytespp];
+
+	QOIPixel index[64];
+	memset(index, 0, sizeof(index));
+	QOIPixel px;
+	px.r = px.g = px.b = 0;
+	px.a = 255;
+	size_t pos = QOI_HEADER_SIZE;
+	size_t end = in.size()-sizeof(qoi_padding);
+	int run = 0;
+	ImageView dst = bottom_up ? ImageView(*this).flipped() : ImageView(*this);
+	unsigned char *p = NULL;
+	for (unsigned long i=0; i<npixels; i++, p+=bytespp) {
+		if (i%width==0) p = dst.row(i/width);
+		if (run>0) {
+			run--;
+		} else if (pos<end) {
+			unsigned char b1 = in[pos++];
+			if (b1==QOI_OP_RGB) {
+				px.r = in[pos]; px.g = in[pos+1]; px.b = in[pos+2];
+				pos += 3;
+			} else if (b1==QOI_OP_RGBA) {
+				px.r = in[pos]; px.g = in[pos+1]; px.b = in[pos+2]; px.a = in[pos+3];
+				pos += 4;
+			} else if ((b1&QOI_MASK_2)==QOI_OP_INDEX) {
+				px = index[b1];
+			} else if ((b1&QOI_MASK_2)==QOI_OP_DIFF) {
+				px.r += ((b1>>4)&3) - 2;
+				px.g += ((b1>>2)&3) - 2;
+				px.b += (b1&3) - 2;
+			} else if ((b1&QOI_MASK_2)==QOI_OP_LUMA) {
+				unsigned char b2 = in[pos++];
+				int vg = (b1&0x3f) - 32;
+				px.r += vg - 8 + ((b2>>4)&0x0f);
+				px.g += vg;
+				px.b += vg - 8 + (b2&0x0f);
+			} else {
+				run = b1&0x3f;
+			}
+			index[qoi_hash(px)] = px;
+		} else {
+			std::cerr << "an error occured while reading the data\n";
+			return false;
+		}
+		p[0] = px.b; p[1] = px.g; p[2] = px.r;
+		if (bytespp==RGBA) p[3] = px.a;
+	}
+	std::cerr << width << "x" << height << "/" << bytespp*8 << "\n";
+	return true;
+}
+
+static bool is_qoi(const char *filename) {
+	size_t n = strlen(filename);
+	return n>=4 && !strcasecmp(filename+n-4, ".qoi");
+}
+
+// picks the codec from the file extension, .qoi or anything else as tga
+bool TGAImage::read_file(const char *filename, bool bottom_up) {
+	return is_qoi(filename) ? read_qoi_file(filename, bottom_up) : read_tga_file(filename, bottom_up);
+}
+
+bool TGAImage::write_file(const char *filename) {
+	return is_qoi(filename) ? write_qoi_file(filename) : write_tga_file(filename);
+}
+
+bool write_file(const ConstImageView& view, const char *filename) {
+	return is_qoi(filename) ? write_qoi_file(view, filename) : write_tga_file(view, filename);
+}
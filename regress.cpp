@@ -0,0 +1,477 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "tgaimage.h"
+#include "geometry.h"
+#include "model.h"
+#include "renderer.h"
+#include "assets.h"
+#include "bvh.h"
+#include "lod.h"
+#include "incremental.h"
+#include "threadpool.h"
+#include "videosink.h"
+#include "regress.h"
+
+// one model of a scene. nm and spec are only used by phong scenes
+struct ScenePart {
+	const char *model;
+	const char *diffuse;
+	const char *nm;
+	const char *spec;
+};
+
+struct Scene {
+	const char *name;
+	std::vector<ScenePart> parts;
+	Vec3f light;
+	bool phong;
+	int crowd; // copies of the first part drawn through its level of detail chain, 0 for a plain scene
+};
+
+static std::vector<Scene> scenes() {
+	std::vector<Scene> s;
+	s.push_back({"head", {
+		{"obj/african_head/african_head.obj", "obj/african_head/african_head_diffuse.tga", NULL, NULL},
+		{"obj/african_head/african_head_eye_inner.obj", "obj/african_head/african_head_eye_inner_diffuse.tga", NULL, NULL},
+	}, Vec3f(0,0,-1), false, 0});
+	s.push_back({"head_phong", {
+		{"obj/african_head/african_head.obj", "obj/african_head/african_head_diffuse.tga", "obj/african_head/african_head_nm_tangent.tga", "obj/african_head/african_head_spec.tga"},
+		{"obj/african_head/african_head_eye_inner.obj", "obj/african_head/african_head_eye_inner_diffuse.tga", "obj/african_head/african_head_eye_inner_nm_tangent.tga", "obj/african_head/african_head_eye_inner_spec.tga"},
+	}, Vec3f(.6f,0,-.8f), true, 0});
+	s.push_back({"diablo", {
+		{"obj/diablo3_pose/diablo3_pose.obj", "obj/diablo3_pose/diablo3_pose_diffuse.tga", NULL, NULL},
+	}, Vec3f(0,0,-1), false, 0});
+	s.push_back({"boggie", {
+		{"obj/floor.obj", "obj/floor_diffuse.tga", NULL, NULL},
+		{"obj/boggie/body.obj", "obj/grid.tga", NULL, NULL},
+		{"obj/boggie/head.obj", "obj/boggie/head_diffuse.tga", NULL, NULL},
+		{"obj/boggie/eyes.obj", "obj/boggie/eyes_diffuse.tga", NULL, NULL},
+	}, Vec3f(0,-.6f,-.8f), false, 0});
+	s.push_back({"crowd", {
+		{"obj/african_head/african_head.obj", "obj/african_head/african_head_diffuse.tga", NULL, NULL},
+	}, Vec3f(0,0,-1), false, 64});
+	return s;
+}
+
+const int REGRESS_SIZES[] = {256, 512, 1000};
+const int REGRESS_THREADS[] = {1, 2, 4};
+
+// a scene's assets, held for the whole run
+struct LoadedPart {
+	ModelHandle model;
+	TextureHandle diffuse, nm, spec;
+	std::shared_ptr<LODChain> lods; // crowd scenes only
+};
+
+static void draw_scene(const Scene& scene, const std::vector<LoadedPart>& parts, TGAImage& image) {
+	if (scene.crowd) {
+		Vec3f camera_pos(0,0,3);
+		render_instances(*parts[0].lods, crowd_instances(scene.crowd, camera_pos), *parts[0].diffuse, image, scene.light, camera_pos);
+		return;
+	}
+	int w = image.get_width(), h = image.get_height();
+	int* zbuffer = new int[w*h];
+	clear_zbuffer(zbuffer, w, h);
+	for (size_t i=0; i<parts.size(); i++) {
+		if (scene.phong) {
+			Material<TGAImage> mat(parts[i].diffuse.get(), parts[i].nm.get(), parts[i].spec.get());
+			render_phong(parts[i].model.get(), mat, image, zbuffer, Instance(), scene.light, Vec3f(0,0,3));
+		} else {
+			render(parts[i].model.get(), *parts[i].diffuse, image, zbuffer, Instance(), scene.light, Vec3f(0,0,3));
+		}
+	}
+	delete[] zbuffer;
+}
+
+// number of pixels with any channel off by more than REGRESS_CHANNEL_TOLERANCE
+static long count_differences(const TGAImage& a, const TGAImage& b, int& max_diff) {
+	max_diff = 0;
+	if (a.get_width()!=b.get_width() || a.get_height()!=b.get_height()) return (long)a.get_width()*a.get_height();
+	long n = 0;
+	for (int y=0; y<a.get_height(); y++) {
+		for (int x=0; x<a.get_width(); x++) {
+			TGAColor ca = a.get(x, y), cb = b.get(x, y);
+			int d = 0;
+			for (int c=0; c<3; c++) d = std::max(d, std::abs((int)ca.raw[c]-(int)cb.raw[c]));
+			max_diff = std::max(max_diff, d);
+			if (d>REGRESS_CHANNEL_TOLERANCE) n++;
+		}
+	}
+	return n;
+}
+
+// times one run of a fixed workload that doesn't touch the renderer. every case is timed next to it and
+// compared as a ratio, so a busy or throttled machine doesn't read as a regression
+static double calibrate() {
+	const int n = 1024;
+	static std::vector<float> a(n*n), b(n*n);
+	for (int i=0; i<n*n; i++) a[i] = (i*31)%255;
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	for (int pass=0; pass<8; pass++) {
+		for (int y=1; y<n-1; y++) {
+			for (int x=1; x<n-1; x++) {
+				b[x+y*n] = (a[x+y*n]*4 + a[x-1+y*n] + a[x+1+y*n] + a[x+(y-1)*n] + a[x+(y+1)*n])*.125f;
+			}
+		}
+		a.swap(b);
+	}
+	volatile float keep = a[n/2]; // so the loops aren't optimized away
+	(void)keep;
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t0).count();
+}
+
+struct Timing {
+	double ms;             // per frame
+	double calibration_ms; // calibrate() at the time
+};
+
+// baseline.json is written by us, one case per line:
+// {"case": "head_512_t1", "ms_per_frame": 12.345, "calibration_ms": 20.123}
+static std::map<std::string, Timing> read_baseline(const std::string& path) {
+	std::map<std::string, Timing> out;
+	std::ifstream in(path.c_str());
+	std::string line;
+	while (std::getline(in, line)) {
+		size_t c = line.find("\"case\": \"");
+		size_t m = line.find("\"ms_per_frame\": ");
+		size_t k = line.find("\"calibration_ms\": ");
+		if (c==std::string::npos || m==std::string::npos || k==std::string::npos) continue;
+		c += 9;
+		size_t end = line.find('"', c);
+		if (end==std::string::npos) continue;
+		Timing t;
+		t.ms = atof(line.c_str()+m+16);
+		t.calibration_ms = atof(line.c_str()+k+18);
+		out[line.substr(c, end-c)] = t;
+	}
+	return out;
+}
+
+static bool write_baseline(const std::string& path, const std::vector<std::pair<std::string, Timing>>& cases) {
+	std::ofstream out(path.c_str());
+	if (out.fail()) {
+		std::cerr << "can't open file " << path << "\n";
+		return false;
+	}
+	out << "{\n\t\"cases\": [\n";
+	for (size_t i=0; i<cases.size(); i++) {
+		char buf[128];
+		snprintf(buf, sizeof(buf), "\"ms_per_frame\": %.3f, \"calibration_ms\": %.3f", cases[i].second.ms, cases[i].second.calibration_ms);
+		out << "\t\t{\"case\": \"" << cases[i].first << "\", " << buf << "}" << (i+1<cases.size() ? "," : "") << "\n";
+	}
+	out << "\t]\n}\n";
+	return !out.fail();
+}
+
+// pure red, green, blue and white 4x4 blocks through the y4m sink and back. chroma is averaged over 2x2
+// blocks, so every sample comes from one color
+static std::string check_y4m_colors() {
+	const TGAColor colors[4] = {TGAColor(255,0,0,255), TGAColor(0,255,0,255), TGAColor(0,0,255,255), TGAColor(255,255,255,255)};
+	const int n = 8;
+	TGAImage frame(n, n, TGAImage::RGB);
+	for (int y=0; y<n; y++) {
+		for (int x=0; x<n; x++) frame.set(x, y, colors[(x/4) + 2*(y/4)]);
+	}
+	char path[] = "/tmp/tinyrenderer_y4m_XXXXXX";
+	int fd = mkstemp(path);
+	if (fd<0) return "can't create a temporary file";
+	close(fd);
+	{
+		VideoSink sink(path, VideoSink::Y4M, n, n);
+		if (!sink.write_frame(ConstImageView(frame).flipped())) return "can't write frame";
+	}
+	std::ifstream in(path, std::ios::binary);
+	std::string header, frame_header;
+	std::getline(in, header);
+	std::getline(in, frame_header);
+	std::vector<unsigned char> yuv(n*n + 2*(n/2)*(n/2));
+	in.read((char *)yuv.data(), yuv.size());
+	bool read = in.good() && frame_header=="FRAME";
+	in.close();
+	unlink(path);
+	if (!read) return "can't read the frame back";
+
+	const unsigned char *py = yuv.data(), *pu = py+n*n, *pv = pu+(n/2)*(n/2);
+	for (int y=0; y<n; y++) {
+		for (int x=0; x<n; x++) {
+			// frames go out top row first
+			TGAColor want = colors[(x/4) + 2*((n-1-y)/4)];
+			float Y = py[x+y*n], U = pu[x/2+(y/2)*(n/2)]-128.f, V = pv[x/2+(y/2)*(n/2)]-128.f;
+			float rgb[3] = {Y + 1.402f*V, Y - .344136f*U - .714136f*V, Y + 1.772f*U};
+			int expected[3] = {want.r, want.g, want.b};
+			for (int c=0; c<3; c++) {
+				if (std::abs(rgb[c]-expected[c]) > 4) {
+					char buf[96];
+					snprintf(buf, sizeof(buf), "pixel %d,%d channel %d is %.0f, expected %d", x, y, c, rgb[c], expected[c]);
+					return buf;
+				}
+			}
+		}
+	}
+	return "";
+}
+
+// pick() through the bvh against a ray test of every face, over a grid of pixels on models with and
+// without many small faces. a different face is only fine when it's hit at the same depth, a shared edge
+static std::string check_pick() {
+	const char *paths[2] = {"obj/diablo3_pose/diablo3_pose.obj", "obj/african_head/african_head.obj"};
+	const int width = 512, step = 4;
+	const Vec3f camera_pos(0, 0, 3);
+	AssetCache assets;
+	for (int k=0; k<2; k++) {
+		ModelHandle model = assets.model(paths[k]);
+		if (!model || !model->nfaces()) return std::string("can't load ") + paths[k];
+		if (!model->nbvh_nodes()) return std::string("no bvh for ") + paths[k];
+		std::vector<Vec3f> verts(model->nverts());
+		for (int i=0; i<model->nverts(); i++) verts[i] = model->vert(i);
+		std::vector<Vec2f> uvs(model->ntexture_verts());
+		for (int i=0; i<model->ntexture_verts(); i++) uvs[i] = model->texture_vert(i);
+		std::vector<Vec3f> normals(model->nnormal_verts());
+		for (int i=0; i<model->nnormal_verts(); i++) normals[i] = model->normal_vert(i);
+		std::vector<std::vector<Vec3i>> faces(model->nfaces());
+		for (int i=0; i<model->nfaces(); i++) faces[i] = model->face(i);
+		// same faces in the same order, without a bvh raycast() tries them all
+		Model brute(verts, uvs, normals, faces);
+		int hits = 0;
+		for (int y=0; y<width; y+=step) {
+			for (int x=0; x<width; x+=step) {
+				RayHit fast, slow;
+				bool got = pick(model.get(), x, y, width, camera_pos, fast);
+				bool want = pick(&brute, x, y, width, camera_pos, slow);
+				bool same = got==want && (!got || fast.face==slow.face || std::abs(fast.t-slow.t) <= 1e-5f*slow.t);
+				if (!same) {
+					char buf[160];
+					snprintf(buf, sizeof(buf), "%s pixel %d,%d picks face %d at %g, every face gives %d at %g", paths[k], x, y,
+						got ? fast.face : -1, got ? fast.t : 0, want ? slow.face : -1, want ? slow.t : 0);
+					return buf;
+				}
+				hits += got;
+			}
+		}
+		if (!hits) return std::string("nothing picked on ") + paths[k];
+	}
+	return "";
+}
+
+// a crowd where one head hops per frame, one leaves and comes back and one gets invalidated, through the
+// incremental renderer. every frame has to match a full redraw exactly, color and depth
+static std::string check_incremental() {
+	const int size = 256, n = 16, frames = 12;
+	const Vec3f light(0,0,-1), camera_pos(0,0,3);
+	AssetCache assets;
+	ModelHandle model = assets.model("obj/african_head/african_head.obj");
+	TextureHandle diffuse = assets.texture("obj/african_head/african_head_diffuse.tga");
+	if (!model || !model->nfaces() || !diffuse) return "can't load the head";
+	std::vector<Instance> instances = crowd_instances(n, camera_pos);
+	IncrementalRenderer<TGAImage> renderer(size, size);
+	std::vector<int> zbuffer(size*size);
+	long redrawn = 0;
+	for (int f=0; f<frames; f++) {
+		std::vector<SceneObject<TGAImage>> objects;
+		for (int i=0; i<n; i++) {
+			Instance xf = instances[i];
+			if (i==f%n) xf.offset.y += .5f*xf.scale;
+			if (i==n-1 && f>=4 && f<8) continue;
+			objects.push_back(SceneObject<TGAImage>(model.get(), diffuse.get(), xf));
+		}
+		if (f==9) renderer.invalidate(2);
+		redrawn += renderer.render(objects, light, camera_pos);
+
+		TGAImage full(size, size, TGAImage::RGB);
+		clear_zbuffer(zbuffer.data(), size, size);
+		for (size_t i=0; i<objects.size(); i++) render(objects[i].model, *objects[i].texture, full, zbuffer.data(), objects[i].xf, light, camera_pos);
+		const TGAImage& image = renderer.image();
+		if (memcmp(image.buffer(), full.buffer(), (size_t)size*size*image.get_bytespp())) return "frame " + std::to_string(f) + " colors differ from a full redraw";
+		if (memcmp(renderer.depth(), zbuffer.data(), size*size*sizeof(int))) return "frame " + std::to_string(f) + " depth differs from a full redraw";
+	}
+	// all but the first frame should have gotten away with part of the image
+	if (redrawn >= (long)frames*renderer.ntiles()) return "every tile was redrawn every frame";
+	return "";
+}
+
+// the banded flips on the shared pool against mirroring through get() and set(), one pixel at a time. the
+// image is odd sized and spans several row chunks, so the middle row and column and chunk edges get covered
+static std::string check_flips() {
+	const int w = 1001, h = 701;
+	const int formats[3] = {TGAImage::GRAYSCALE, TGAImage::RGB, TGAImage::RGBA};
+	for (int k=0; k<3; k++) {
+		TGAImage image(w, h, formats[k]);
+		unsigned int seed = 1;
+		for (int y=0; y<h; y++) {
+			for (int x=0; x<w; x++) {
+				seed = seed*1664525u + 1013904223u;
+				image.set(x, y, TGAColor(seed>>24, seed>>16, seed>>8, seed));
+			}
+		}
+		TGAImage want(w, h, formats[k]);
+		for (int y=0; y<h; y++) {
+			for (int x=0; x<w; x++) want.set(w-1-x, h-1-y, image.get(x, y));
+		}
+		image.flip_horizontally();
+		image.flip_vertically();
+		size_t bytes = (size_t)w*h*formats[k];
+		if (memcmp(image.buffer(), want.buffer(), bytes)) return std::to_string(formats[k]) + " bytes per pixel flips differ from a serial flip";
+		image.clear();
+		for (size_t i=0; i<bytes; i++) {
+			if (image.buffer()[i]) return std::to_string(formats[k]) + " bytes per pixel clear left byte " + std::to_string(i);
+		}
+	}
+	return "";
+}
+
+// checks that need no golden images or baseline. each gives back what went wrong, empty when it passed
+struct Check {
+	const char *name;
+	std::function<std::string()> run;
+};
+
+static std::vector<Check> checks() {
+	std::vector<Check> c;
+	c.push_back({"y4m_colors", check_y4m_colors});
+	c.push_back({"pick", check_pick});
+	c.push_back({"incremental", check_incremental});
+	c.push_back({"flips", check_flips});
+	return c;
+}
+
+int run_regression(const char *dir, bool record, float threshold) {
+	std::string base_path = std::string(dir) + "/baseline.json";
+	std::map<std::string, Timing> baseline;
+	if (record) {
+		mkdir(dir, 0755);
+	} else {
+		baseline = read_baseline(base_path);
+		if (baseline.empty()) std::cerr << "no baseline in " << base_path << ", run with --record first\n";
+	}
+
+	AssetCache assets;
+	std::vector<Scene> all = scenes();
+	std::vector<std::pair<std::string, Timing>> timings;
+	int failures = 0;
+	for (size_t s=0; s<all.size(); s++) {
+		const Scene& scene = all[s];
+		std::vector<LoadedPart> parts;
+		for (size_t i=0; i<scene.parts.size(); i++) {
+			LoadedPart p;
+			p.model = assets.model(scene.parts[i].model);
+			p.diffuse = assets.texture(scene.parts[i].diffuse);
+			if (scene.parts[i].nm) p.nm = assets.texture(scene.parts[i].nm);
+			if (scene.parts[i].spec) p.spec = assets.texture(scene.parts[i].spec);
+			if (scene.crowd) p.lods = std::make_shared<LODChain>(scene.parts[i].model);
+			if (!p.model || !p.diffuse) {
+				std::cerr << "can't load scene " << scene.name << "\n";
+				return 1;
+			}
+			parts.push_back(p);
+		}
+
+		for (int size : REGRESS_SIZES) {
+			std::string golden_path = std::string(dir) + "/" + scene.name + "_" + std::to_string(size) + ".qoi";
+			// goldens are stored top-down like any output, read bottom-up they line up with the raw renders
+			TGAImage golden;
+			bool have_golden = !record && golden.read_file(golden_path.c_str(), true);
+			if (!record && !have_golden) failures++;
+
+			for (int threads : REGRESS_THREADS) {
+				std::string name = std::string(scene.name) + "_" + std::to_string(size) + "_t" + std::to_string(threads);
+				// every frame is the same render, they're only spread over the threads. the first run is
+				// REGRESS_FRAMES long and sizes the rest so short renders still get timed over REGRESS_MIN_MS
+				std::vector<TGAImage> frames(REGRESS_FRAMES);
+				Timing best = {0, 0};
+				int nframes = REGRESS_FRAMES;
+				ThreadPool pool(threads);
+				for (int r=0; r<=REGRESS_REPEATS; r++) {
+					double cal = calibrate();
+					std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+					for (int f=0; f<nframes; f++) {
+						pool.submit([&, f]() {
+							TGAImage image(size, size, TGAImage::RGB);
+							draw_scene(scene, parts, image);
+							if (f<REGRESS_FRAMES) frames[f] = image;
+						});
+					}
+					pool.wait();
+					double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t0).count()/nframes;
+					if (r==0) {
+						nframes = std::max(REGRESS_FRAMES, std::min(1000, (int)(REGRESS_MIN_MS/ms)+1));
+						nframes = (nframes+threads-1)/threads*threads;
+						continue;
+					}
+					if (r==1 || ms<best.ms) best.ms = ms;
+					if (r==1 || cal<best.calibration_ms) best.calibration_ms = cal;
+				}
+				timings.push_back(std::make_pair(name, best));
+
+				// the baseline scaled to how fast the machine is running right now
+				double expected = 0;
+				std::map<std::string, Timing>::iterator it = baseline.find(name);
+				if (it!=baseline.end()) expected = it->second.ms*best.calibration_ms/it->second.calibration_ms;
+
+				std::string status = "ok";
+				if (record) {
+					status = "recorded";
+					if (threads==REGRESS_THREADS[0] && !write_file(ConstImageView(frames[0]).flipped(), golden_path.c_str())) failures++;
+				} else {
+					// images
+					int max_diff = 0;
+					long worst = 0;
+					for (int f=0; f<REGRESS_FRAMES; f++) {
+						long d = have_golden ? count_differences(frames[f], golden, max_diff) : (long)size*size;
+						worst = std::max(worst, d);
+					}
+					if (worst > REGRESS_PIXEL_TOLERANCE*size*size) {
+						status = "IMAGE " + std::to_string(worst) + " px differ";
+						failures++;
+					}
+					// time
+					if (it==baseline.end()) {
+						if (status=="ok") status = "no baseline";
+						failures++;
+					} else if (best.ms > expected*(1+threshold)) {
+						char buf[64];
+						snprintf(buf, sizeof(buf), "SLOWER %+.1f%%", (best.ms/expected-1)*100);
+						status = status=="ok" ? buf : status + ", " + buf;
+						failures++;
+					}
+				}
+				char line[128];
+				snprintf(line, sizeof(line), "%-20s %9.3f ms/frame", name.c_str(), best.ms);
+				std::cout << line;
+				if (expected>0) {
+					snprintf(line, sizeof(line), "  expected %9.3f", expected);
+					std::cout << line;
+				}
+				std::cout << "  " << status << std::endl;
+			}
+		}
+	}
+
+	std::vector<Check> all_checks = checks();
+	for (size_t i=0; i<all_checks.size(); i++) {
+		std::string error = all_checks[i].run();
+		char line[128];
+		snprintf(line, sizeof(line), "check %-14s", all_checks[i].name);
+		std::cout << line << "  " << (error.empty() ? "ok" : "FAIL " + error) << std::endl;
+		if (!error.empty()) failures++;
+	}
+
+	if (record && !write_baseline(base_path, timings)) failures++;
+	std::cout << (failures ? "FAIL " : "PASS ") << failures << " problem(s)" << std::endl;
+	return failures ? 1 : 0;
+}
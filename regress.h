@@ -0,0 +1,20 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_REGRESS_H
+#define TATE_REGRESS_H
+
+const float REGRESS_THRESHOLD = .25f;        // fail when a case gets this much slower than the baseline
+const int REGRESS_CHANNEL_TOLERANCE = 2;     // per channel difference that still counts as the same pixel
+const float REGRESS_PIXEL_TOLERANCE = .001f; // fraction of pixels allowed to differ from the golden image
+const int REGRESS_FRAMES = 8;                // frames per case whose images get checked
+const float REGRESS_MIN_MS = 250;            // each timed run renders enough frames to take at least this long
+const int REGRESS_REPEATS = 5;               // best of this many runs is what gets compared
+
+// renders the fixed scenes over obj/ at several resolutions and thread counts. the images are checked
+// against golden references in dir/<scene>_<size>.qoi and the frame times against dir/baseline.json.
+// record writes both instead. then a few fixed checks run that need neither, like colors surviving the y4m
+// sink. returns 0 when everything matches and nothing got slower than threshold
+int run_regression(const char *dir, bool record, float threshold=REGRESS_THRESHOLD);
+
+#endif // TATE_REGRESS_H
@@ -4,71 +4,163 @@
 #include <iostream>
 #include <vector>
 #include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cstring>
 #include "tgaimage.h"
 #include "geometry.h"
 #include "model.h"
 #include "renderer.h"
+#include "meshopt.h"
+#include "bvh.h"
+#include "lod.h"
+#include "bctexture.h"
+#include "oit.h"
+#include "imageview.h"
+#include "compactmesh.h"
+#include "trace.h"
+
+const int TRI_BLOCK = 8; // triangles with a bigger bounding box than this are rasterized a block at a time
+
+// the half of barycentric() that only depends on the triangle, worked out once so the rasterizer's loops
+// only do the per pixel half. at() is the same arithmetic in the same order, so the results are too
+struct Barycentric {
+	float p0x, p0y;
+	float ax, bx, ay, by; // the edges from corner 0 to corners 2 and 1
+	float inv_area;
+	bool degenerate;
+	Barycentric(const Vec3f* pts, float min_area) : p0x(pts[0].x), p0y(pts[0].y), ax(pts[2].x-pts[0].x), bx(pts[1].x-pts[0].x),
+		ay(pts[2].y-pts[0].y), by(pts[1].y-pts[0].y) {
+		float area = ax*by-bx*ay;
+		degenerate = std::abs(area)<min_area;
+		inv_area = 1.f/area;
+	}
+	Vec3f at(int x, int y) const {
+		float cx = p0x-x, cy = p0y-y;
+		float u = (bx*cy-cx*by)*inv_area;
+		float v = (cx*ay-ax*cy)*inv_area;
+		return Vec3f(1-u-v, u, v);
+	}
+	// false only if no pixel in x0..x1, y0..y1 can be inside. the weights are affine so each is at its
+	// largest on a corner. they're taken in double and have to miss by well over what at()'s float
+	// rounding could make up, so a block that's skipped really has nothing in it
+	bool may_cover(int x0, int y0, int x1, int y1) const {
+		double hi[3] = {-1e30, -1e30, -1e30}, mag = 0;
+		for (int k=0; k<4; k++) {
+			double cx = (double)p0x-(k&1 ? x1 : x0), cy = (double)p0y-(k&2 ? y1 : y0);
+			double u = (bx*cy-cx*by)*inv_area, v = (cx*ay-ax*cy)*inv_area;
+			hi[0] = std::max(hi[0], 1-u-v);
+			hi[1] = std::max(hi[1], u);
+			hi[2] = std::max(hi[2], v);
+			mag = std::max(mag, (std::abs(bx*cy)+std::abs(cx*by)+std::abs(cx*ay)+std::abs(ax*cy))*std::abs(inv_area));
+		}
+		double tol = 1e-4 + 1e-5*mag;
+		return hi[0]>=-tol && hi[1]>=-tol && hi[2]>=-tol;
+	}
+};
+
+// barycentric() and Barycentric::at() hand back the weights of corners 0, 2 and 1, in that order. every
+// rasterizer goes through this to get them in real corner order, so depth, uv and everything else stored
+// per corner are interpolated with the same weights
+static inline Vec3f corner_weights(Vec3f b) {
+	return Vec3f(b.x, b.z, b.y);
+}
 
 // Gets barycentric coordinates of P within the triangle defined by pts (screen coords)
-// pts must have length 3
-Vec3f barycentric(Vec3f* pts, Vec2i P) {
-	Vec3f vx = Vec3f(pts[2].x - pts[0].x, pts[1].x - pts[0].x, pts[0].x - P.x);
-	Vec3f vy = Vec3f(pts[2].y - pts[0].y, pts[1].y - pts[0].y, pts[0].y - P.y);
-	Vec3f u = vx^vy; // cross product
-	
+// pts must have length 3. min_area is twice the area, in pixels, below which the triangle counts as degenerate
+Vec3f barycentric(Vec3f* pts, Vec2i P, float min_area) {
+	Barycentric bc(pts, min_area);
 	// if area is nearly zero, it's degenerate
-	if (std::abs(u.z)<1) return Vec3f(-1,1,1);
-	// normalize
-	u = u*(1.f/u.z);
-	// store results as cartesian coordinates
-	Vec3f b = Vec3f(1-u.x-u.y, u.x, u.y);
-	return b;
+	if (bc.degenerate) return Vec3f(-1,1,1);
+	return bc.at(P.x, P.y);
 }
 
-// triangle draw with zbuffer, model_uv, and light_level
-void triangle(Vec3f screen_pos[], int* zbuffer, Vec2f vt[], TGAImage& model_uv, TGAImage& image, float light_level) {
+// triangle draw with zbuffer, model_uv, and light_level. image and zbuffer cover the pixels from origin on,
+// the screen positions are left as they are so a tile computes every pixel exactly as the whole image would.
+// most triangles of a dense mesh cover a handful of pixels, so the bounding box is sized up first: a small
+// one is walked straight through, a big one a block at a time, skipping blocks that miss the triangle
+template <class Texture> void triangle(Vec3f screen_pos[], int* zbuffer, Vec2f vt[], const Texture& model_uv, const ImageView& image, float light_level, RenderStats* stats, float min_area, Vec2i origin) {
 	int w = image.get_width();
 	int h = image.get_height();
+	int ox = origin.x, oy = origin.y;
 
 	// find bounding box
-	Vec2i bboxmin = Vec2i(w-1, h-1);
-	Vec2i bboxmax = Vec2i(0, 0);
+	Vec2i bboxmin = Vec2i(ox+w-1, oy+h-1);
+	Vec2i bboxmax = Vec2i(ox, oy);
 	for (int i=0; i<3; i++) {
 		if (screen_pos[i].x < bboxmin.x) bboxmin.x = screen_pos[i].x;
 		if (screen_pos[i].y < bboxmin.y) bboxmin.y = screen_pos[i].y;
 		if (screen_pos[i].x > bboxmax.x) bboxmax.x = screen_pos[i].x;
 		if (screen_pos[i].y > bboxmax.y) bboxmax.y = screen_pos[i].y;
 	}
-	if (bboxmin.x<0) bboxmin.x=0;
-	if (bboxmin.y<0) bboxmin.y=0;
-	if (bboxmax.x>w-1) bboxmax.x=w-1;
-	if (bboxmax.y>h-1) bboxmax.y=h-1;
+	if (bboxmin.x<ox) bboxmin.x=ox;
+	if (bboxmin.y<oy) bboxmin.y=oy;
+	if (bboxmax.x>ox+w-1) bboxmax.x=ox+w-1;
+	if (bboxmax.y>oy+h-1) bboxmax.y=oy+h-1;
 
-	// draw
-	Vec2i P;
-	for (P.x=bboxmin.x; P.x<=bboxmax.x; P.x++) {
-		for (P.y=bboxmin.y; P.y<=bboxmax.y; P.y++) {
-			Vec3f b = barycentric(screen_pos, P);
-			const float EPS = 0;
-			// if pixel is inside the triangle
-			if (b.x>=-EPS && b.y>=-EPS && b.z>=-EPS) {
-				int z = b * Vec3f(screen_pos[0].z, screen_pos[1].z, screen_pos[2].z);
-				// if pixel is in front of the current pixel at x,y
-				if (z>zbuffer[P.x+P.y*w]) {
-					zbuffer[P.x+P.y*w] = z;
-					float u = b * Vec3f(vt[0].u, vt[1].u, vt[2].u);
-					float v = b * Vec3f(vt[0].v, vt[1].v, vt[2].v);
-					TGAColor color = model_uv.get(u*model_uv.get_width(), v*model_uv.get_height());
-					color = TGAColor(color.r*light_level, color.g*light_level, color.b*light_level, color.a);
-					image.set(P.x, P.y, color);
+	// draw. the bounding box is already clipped so pixels go straight into the view
+	Barycentric bc(screen_pos, min_area);
+	int bpp = image.get_bytespp();
+	long fragments = 0, shaded = 0, line_changes = 0;
+	long last_line = -1;
+	Vec3f depth(screen_pos[0].z, screen_pos[1].z, screen_pos[2].z);
+	// vt is in the loader's uv order, corners 1 and 2 swapped
+	Vec3f tu(vt[0].u, vt[2].u, vt[1].u), tv(vt[0].v, vt[2].v, vt[1].v);
+	auto pixel = [&](int x, int y) {
+		Vec3f b = corner_weights(bc.at(x, y));
+		const float EPS = 0;
+		// if pixel is inside the triangle
+		if (b.x>=-EPS && b.y>=-EPS && b.z>=-EPS) {
+			fragments++;
+			int z = b * depth;
+			// if pixel is in front of the current pixel at x,y
+			int* zp = zbuffer+(x-ox)+(y-oy)*w;
+			if (z>*zp) {
+				*zp = z;
+				float u = b * tu;
+				float v = b * tv;
+				int tx = u*model_uv.get_width();
+				int ty = v*model_uv.get_height();
+				TGAColor color = model_uv.get(tx, ty);
+				color = TGAColor(color.r*light_level, color.g*light_level, color.b*light_level, color.a);
+				memcpy(image.pixel(x-ox, y-oy), color.raw, bpp);
+				shaded++;
+				if (stats) {
+					long texel_line = (tx + (long)ty*model_uv.get_width())*model_uv.get_bytespp()/64;
+					if (texel_line!=last_line) line_changes++;
+					last_line = texel_line;
+				}
+			}
+		}
+	};
+	if (bc.degenerate) {
+		// nothing to draw
+	} else if (bboxmax.x-bboxmin.x<TRI_BLOCK && bboxmax.y-bboxmin.y<TRI_BLOCK) {
+		for (int y=bboxmin.y; y<=bboxmax.y; y++) {
+			for (int x=bboxmin.x; x<=bboxmax.x; x++) pixel(x, y);
+		}
+	} else {
+		for (int by=bboxmin.y; by<=bboxmax.y; by+=TRI_BLOCK) {
+			int by1 = std::min(by+TRI_BLOCK-1, bboxmax.y);
+			for (int bx=bboxmin.x; bx<=bboxmax.x; bx+=TRI_BLOCK) {
+				int bx1 = std::min(bx+TRI_BLOCK-1, bboxmax.x);
+				if (!bc.may_cover(bx, by, bx1, by1)) continue;
+				for (int y=by; y<=by1; y++) {
+					for (int x=bx; x<=bx1; x++) pixel(x, y);
 				}
 			}
 		}
 	}
+	if (stats) {
+		stats->faces++;
+		stats->fragments += fragments;
+		stats->fragments_shaded += shaded;
+		stats->texel_line_changes += line_changes;
+	}
 }
 
 // rasterize triangle, translate to screen coords and draw
-void rasterize(Vec3f world_pos[], int* zbuffer, Vec2f vt[], TGAImage& model_uv, TGAImage& image, float light_level, float scale, Vec3f camera_pos) {
+template <class Texture> void rasterize(Vec3f world_pos[], int* zbuffer, Vec2f vt[], const Texture& model_uv, const ImageView& image, float light_level, float scale, Vec3f camera_pos, RenderStats* stats) {
 	// calculate screen positions
 	for (int i=0; i<3; i++) {
 		// world_pos[i].z += 1;
@@ -82,47 +174,719 @@ void rasterize(Vec3f world_pos[], int* zbuffer, Vec2f vt[], TGAImage& model_uv,
 		screen_pos[i].z = (world_pos[i].z*coef+1)*scale;
 	}
 
-	triangle(screen_pos, zbuffer, vt, model_uv, image, light_level);
+	triangle(screen_pos, zbuffer, vt, model_uv, image, light_level, stats);
+}
+
+// rasterizes face i of the model at the light level visible_faces() gave it, projected through vp. with both
+// scales at w/2 and no origin it's the same as rasterize(). a smaller scale is a subsampled pass, and
+// whether the face is too thin to draw is still judged at depth_scale's size
+template <class Texture> static void render_face(const Model* model, int i, const Instance& xf, int* zbuffer, const Texture& model_uv, const ImageView& image, float light_level, const Viewport& vp, Vec3f camera_pos, RenderStats* stats) {
+	const std::vector<Vec3i>& f = model->face(i);
+	Vec3f screen_pos[3];
+	Vec2f vt[3];
+	for (int i=0; i<3; i++) {
+		Vec3f p = model->vert(f[i].ivert)*xf.scale + xf.offset;
+		float coef = 1.-p.z/(float)camera_pos.z;
+		coef = 1./coef;
+		screen_pos[i].x = (p.x*coef+1)*vp.scale;
+		screen_pos[i].y = (p.y*coef+1)*vp.scale;
+		screen_pos[i].z = (p.z*coef+1)*vp.depth_scale;
+		vt[i] = model->texture_vert(f[i].iuv);
+	}
+	float step = vp.depth_scale/vp.scale;
+	triangle(screen_pos, zbuffer, vt, model_uv, image, light_level, stats, 1/(step*step), Vec2i(vp.x0, vp.y0));
+}
+
+// the faces left after visible_faces(), with their flat light levels
+struct VisibleFaces {
+	int n;
+	std::vector<int> face;
+	std::vector<float> light;
+	std::vector<float> level;         // scratch
+	std::vector<unsigned char> keep;  // scratch
+	VisibleFaces() : n(0) {}
+};
+
+// tests faces first..first+count-1 in one go from the model's per face arrays and keeps the ones that
+// could draw something: not degenerate, not entirely off one side of the w x h window vp looks through, and
+// facing the light (facing_light) or the camera. the loop is straight float math over the arrays so it vectorizes
+static void visible_faces(const Model* model, int first, int count, const Instance& xf, Vec3f to_light, Vec3f camera_pos, int w, int h, const Viewport& vp, bool facing_light, VisibleFaces& out) {
+	if ((int)out.face.size()<count) {
+		out.face.resize(count);
+		out.light.resize(count);
+		out.level.resize(count);
+		out.keep.resize(count);
+	}
+	const float *nx = model->face_normals(0)+first, *ny = model->face_normals(1)+first, *nz = model->face_normals(2)+first;
+	const float *d = model->face_offsets()+first, *area = model->face_areas()+first;
+	const float *x0 = model->face_bmin(0)+first, *y0 = model->face_bmin(1)+first, *z0 = model->face_bmin(2)+first;
+	const float *x1 = model->face_bmax(0)+first, *y1 = model->face_bmax(1)+first, *z1 = model->face_bmax(2)+first;
+	// the camera in model space for the back face test
+	Vec3f eye = (camera_pos-xf.offset)*(1.f/xf.scale);
+	// a point is in the window when xmin <= x*coef <= xmax with coef = 1/(1-z/c), ie. xmin*(1-z/c) <= x <=
+	// xmax*(1-z/c) for a camera in front. a face is off when it's past that for every z it spans, the edges
+	// move with z so take whichever of its nearest and farthest is the looser
+	float xmin = vp.x0/vp.scale-1, xmax = (vp.x0+w)/vp.scale-1;
+	float ymin = vp.y0/vp.scale-1, ymax = (vp.y0+h)/vp.scale-1;
+	float inv_c = camera_pos.z>0 ? 1.f/camera_pos.z : 0;
+	float s = xf.scale;
+	float *level = out.level.data();
+	unsigned char *keep = out.keep.data();
+	for (int i=0; i<count; i++) {
+		float l = nx[i]*to_light.x + ny[i]*to_light.y + nz[i]*to_light.z;
+		float facing = nx[i]*eye.x + ny[i]*eye.y + nz[i]*eye.z - d[i];
+		float near = 1-(z0[i]*s+xf.offset.z)*inv_c, far = 1-(z1[i]*s+xf.offset.z)*inv_c;
+		bool off = x0[i]*s+xf.offset.x > std::max(xmax*near, xmax*far) || x1[i]*s+xf.offset.x < std::min(xmin*near, xmin*far)
+			|| y0[i]*s+xf.offset.y > std::max(ymax*near, ymax*far) || y1[i]*s+xf.offset.y < std::min(ymin*near, ymin*far);
+		bool front = facing_light ? l>0 : facing>0;
+		level[i] = l;
+		keep[i] = (area[i]>0) & front & !(off & (inv_c>0));
+	}
+	// compact without branching on keep
+	int k = 0;
+	for (int i=0; i<count; i++) {
+		out.face[k] = first+i;
+		out.light[k] = level[i];
+		k += keep[i];
+	}
+	out.n = k;
+}
+
+// projects the corners of a box through vp into its w x h window. false if the box lands entirely outside it
+static bool project_box(Vec3f bmin, Vec3f bmax, const Viewport& vp, Vec3f camera_pos, int w, int h, ScreenRect& r) {
+	float x0 = std::numeric_limits<float>::max(), y0 = x0, z1 = std::numeric_limits<float>::lowest();
+	float x1 = z1, y1 = z1;
+	for (int i=0; i<8; i++) {
+		Vec3f p = Vec3f(i&1 ? bmax.x : bmin.x, i&2 ? bmax.y : bmin.y, i&4 ? bmax.z : bmin.z);
+		float coef = 1.-p.z/(float)camera_pos.z;
+		if (coef<=0) {
+			// behind the camera, the projection is meaningless so assume it covers everything
+			r.x0 = 0; r.y0 = 0; r.x1 = w-1; r.y1 = h-1;
+			r.zmax = std::numeric_limits<int>::max();
+			return true;
+		}
+		coef = 1./coef;
+		float x = (p.x*coef+1)*vp.scale-vp.x0;
+		float y = (p.y*coef+1)*vp.scale-vp.y0;
+		float z = (p.z*coef+1)*vp.depth_scale;
+		x0 = std::min(x0, x); x1 = std::max(x1, x);
+		y0 = std::min(y0, y); y1 = std::max(y1, y);
+		z1 = std::max(z1, z);
+	}
+	if (x1<0 || y1<0 || x0>w-1 || y0>h-1) return false;
+	r.x0 = std::max(0, (int)std::floor(x0));
+	r.y0 = std::max(0, (int)std::floor(y0));
+	r.x1 = std::min(w-1, (int)std::ceil(x1));
+	r.y1 = std::min(h-1, (int)std::ceil(y1));
+	r.zmax = (int)std::ceil(z1);
+	return true;
+}
+
+// coarse occlusion buffer: the farthest zbuffer depth in each HIZ_TILE*HIZ_TILE tile.
+// tiles are only computed when they're first queried and again after something drew over them,
+// so whatever was already in the zbuffer counts too
+const int HIZ_TILE = 8;
+class HiZ {
+	int* zbuffer;
+	int w, h, tw, th;
+	std::vector<int> tile_min;
+	std::vector<bool> dirty;
+	int tile(int tx, int ty) {
+		int i = tx+ty*tw;
+		if (dirty[i]) {
+			int m = std::numeric_limits<int>::max();
+			for (int y=ty*HIZ_TILE; y<std::min(h, (ty+1)*HIZ_TILE); y++) {
+				for (int x=tx*HIZ_TILE; x<std::min(w, (tx+1)*HIZ_TILE); x++) {
+					m = std::min(m, zbuffer[x+y*w]);
+				}
+			}
+			tile_min[i] = m;
+			dirty[i] = false;
+		}
+		return tile_min[i];
+	}
+public:
+	HiZ(int* zbuffer, int w, int h) : zbuffer(zbuffer), w(w), h(h), tw((w+HIZ_TILE-1)/HIZ_TILE), th((h+HIZ_TILE-1)/HIZ_TILE),
+		tile_min(tw*th, std::numeric_limits<int>::min()), dirty(tw*th, true) {}
+	// true if everything in r is behind what's already in the zbuffer
+	bool occluded(const ScreenRect& r) {
+		for (int ty=r.y0/HIZ_TILE; ty<=r.y1/HIZ_TILE; ty++) {
+			for (int tx=r.x0/HIZ_TILE; tx<=r.x1/HIZ_TILE; tx++) {
+				if (r.zmax>=tile(tx, ty)) return false;
+			}
+		}
+		return true;
+	}
+	void touch(const ScreenRect& r) {
+		for (int ty=r.y0/HIZ_TILE; ty<=r.y1/HIZ_TILE; ty++) {
+			for (int tx=r.x0/HIZ_TILE; tx<=r.x1/HIZ_TILE; tx++) {
+				dirty[tx+ty*tw] = true;
+			}
+		}
+	}
+};
+
+// walks the bvh nearest child first, rejecting whole nodes and meshlets before touching their faces
+// draw_faces(first, n) rasterizes a run of faces. meshlets whose faces all point away from cull_dir are
+// skipped, a zero cull_dir keeps them all
+template <class DrawFaces> static void render_bvh(const Model* model, const Instance& xf, int* zbuffer, int w, int h, Vec3f cull_dir, const Viewport& vp, Vec3f camera_pos, RenderStats* stats, DrawFaces draw_faces) {
+	HiZ hiz(zbuffer, w, h);
+	long culled = 0, drawn = 0;
+	// the cone test below compares against sin of the cone angle, so it wants a unit direction
+	if (cull_dir*cull_dir>0) cull_dir.normalize();
+	std::vector<int> stack(1, 0);
+	while (!stack.empty()) {
+		BVHNode node = model->bvh_node(stack.back());
+		stack.pop_back();
+		ScreenRect r;
+		if (!project_box(node.bmin*xf.scale+xf.offset, node.bmax*xf.scale+xf.offset, vp, camera_pos, w, h, r) || hiz.occluded(r)) {
+			culled += node.nmeshlets;
+			continue;
+		}
+		if (node.left>=0) {
+			BVHNode l = model->bvh_node(node.left);
+			BVHNode rt = model->bvh_node(node.right);
+			Vec3f dl = (l.bmin+l.bmax)*(.5f*xf.scale) + xf.offset - camera_pos;
+			Vec3f dr = (rt.bmin+rt.bmax)*(.5f*xf.scale) + xf.offset - camera_pos;
+			bool left_first = dl*dl < dr*dr;
+			stack.push_back(left_first ? node.right : node.left);
+			stack.push_back(left_first ? node.left : node.right);
+			continue;
+		}
+		for (int k=node.first_meshlet; k<node.first_meshlet+node.nmeshlets; k++) {
+			Meshlet m = model->meshlet(k);
+			// every face in the cone faces away from cull_dir, visible_faces() would drop them all
+			float sin_cone = std::sqrt(std::max(0.f, 1-m.cone_cutoff*m.cone_cutoff));
+			bool away = m.cone_cutoff>0 && cull_dir*cull_dir>0 && m.cone_axis*cull_dir < -sin_cone-1e-4f;
+			if (away || !project_box(m.bmin*xf.scale+xf.offset, m.bmax*xf.scale+xf.offset, vp, camera_pos, w, h, r) || hiz.occluded(r)) {
+				culled++;
+				continue;
+			}
+			draw_faces(m.first_face, m.nfaces);
+			hiz.touch(r);
+			drawn++;
+		}
+	}
+	if (stats) {
+		stats->meshlets_culled += culled;
+		stats->meshlets_drawn += drawn;
+	}
+}
+
+// screen space bounds of the model's bounding box in a w*h image, false if it's entirely off screen
+bool screen_rect(const Model* model, const Instance& xf, int w, int h, Vec3f camera_pos, ScreenRect& r) {
+	return project_box(model->min*xf.scale+xf.offset, model->max*xf.scale+xf.offset, Viewport(w/2, w/2), camera_pos, w, h, r);
+}
+
+void clear_zbuffer(int* zbuffer, int w, int h) {
+	for (int i=0; i<w; i++) {
+		for (int j=0; j<h; j++) {
+			zbuffer[i+j*w] = std::numeric_limits<int>::min();
+		}
+	}
+}
+
+// approximate screen area in pixels covered by the model's bounding sphere
+float screen_area(const Model* model, const Instance& xf, float scale, Vec3f camera_pos) {
+	Vec3f center = (model->min+model->max)*(.5f*xf.scale) + xf.offset;
+	float radius = (model->max-model->min).norm()*.5f*xf.scale;
+	float coef = 1.-(center.z+radius)/(float)camera_pos.z;
+	if (coef<=0) return std::numeric_limits<float>::max();
+	float r = radius/coef*scale;
+	return M_PI*r*r;
+}
+
+// draws one placement of the model into image and zbuffer without clearing either
+template <class Texture> void render(const Model* model, const Texture& model_uv, const ImageView& image, int* zbuffer, const Instance& xf, Vec3f light_source, Vec3f camera_pos, RenderStats* stats) {
+	// calculate scale
+	render_viewport(model, model_uv, image, zbuffer, xf, light_source, camera_pos, Viewport(image.get_width()/2, image.get_width()/2), stats);
+}
+
+// render() with the projection given rather than taken from the image width
+template <class Texture> void render_viewport(const Model* model, const Texture& model_uv, const ImageView& image, int* zbuffer, const Instance& xf, Vec3f light_source, Vec3f camera_pos, const Viewport& vp, RenderStats* stats) {
+	TRACE_SCOPE("render");
+	Vec3f to_light = Vec3f()-light_source;
+	VisibleFaces visible;
+	// traced a batch at a time, a meshlet's faces or the whole mesh
+	auto draw_faces = [&](int first, int n) {
+		{
+			TRACE_SCOPE("face setup");
+			visible_faces(model, first, n, xf, to_light, camera_pos, image.get_width(), image.get_height(), vp, true, visible);
+		}
+		TRACE_SCOPE("rasterize");
+		for (int k=0; k<visible.n; k++) {
+			render_face(model, visible.face[k], xf, zbuffer, model_uv, image, visible.light[k], vp, camera_pos, stats);
+		}
+	};
+
+	if (model->nbvh_nodes()>0) {
+		render_bvh(model, xf, zbuffer, image.get_width(), image.get_height(), to_light, vp, camera_pos, stats, draw_faces);
+	} else if (model->nmeshlets()>0) {
+		// draw meshlets nearest first so the zbuffer rejects more of what's behind them
+		std::vector<int> order = meshlet_order(model, (camera_pos-xf.offset)*(1.f/xf.scale));
+		for (size_t k=0; k<order.size(); k++) {
+			Meshlet m = model->meshlet(order[k]);
+			draw_faces(m.first_face, m.nfaces);
+		}
+	} else {
+		draw_faces(0, model->nfaces());
+	}
 }
 
 // draws the model using the light_source vector, describing light's direction as a normalized vec3f
-void render(Model* model, TGAImage& model_uv, TGAImage& image, Vec3f light_source, Vec3f camera_pos) {
+template <class Texture> void render(const Model* model, const Texture& model_uv, const ImageView& image, Vec3f light_source, Vec3f camera_pos, RenderStats* stats) {
 	int w = image.get_width();
 	int h = image.get_height();
 	
 	// create zbuffer
 	int* zbuffer = new int[w*h];
-	for (int i=0; i<w; i++) {
-		for (int j=0; j<h; j++) {
-			zbuffer[i+j*w] = std::numeric_limits<int>::min();
+	clear_zbuffer(zbuffer, w, h);
+
+	render(model, model_uv, image, zbuffer, Instance(), light_source, camera_pos, stats);
+
+	delete[] zbuffer;
+}
+
+// every vertex of a CompactMesh in world space and on screen, with its uv, and every face's normal against
+// the light. scratch for render(), kept per thread so a frame only allocates when it meets a bigger mesh
+struct CompactVerts {
+	std::vector<float> wx, wy, wz, sx, sy, sz, u, v;
+	std::vector<float> facing, len2; // normal*to_light and normal*normal, the decoded normal isn't unit
+};
+static thread_local CompactVerts compact_scratch;
+
+// q*k+b for n values
+static void dequantize(int n, const uint16_t *__restrict q, float k, float b, float *__restrict out) {
+	for (int i=0; i<n; i++) out[i] = q[i]*k+b;
+}
+
+// one screen coordinate for n points, projected like rasterize() does using each point's world z
+static void project(int n, const float *__restrict world, const float *__restrict z, float inv_c, float scale, float *__restrict screen) {
+	for (int i=0; i<n; i++) screen[i] = (world[i]/(1.f-z[i]*inv_c)+1)*scale;
+}
+
+// the transform stage for a CompactMesh: dequantizes positions and uvs, places and projects them. the
+// instance transform folds into the dequantize step, and every pass is one flat loop over separate
+// arrays so each vectorizes (a single fused loop needs more alias checks than gcc will version for)
+static void transform_compact(const CompactMesh* mesh, const Instance& xf, float scale, Vec3f camera_pos, CompactVerts& out) {
+	int n = mesh->nverts();
+	std::vector<float>* arrays[8] = {&out.wx, &out.wy, &out.wz, &out.sx, &out.sy, &out.sz, &out.u, &out.v};
+	for (int k=0; k<8; k++) arrays[k]->resize(n);
+	dequantize(n, mesh->px.data(), mesh->pos_step.x*xf.scale, mesh->pos_base.x*xf.scale+xf.offset.x, out.wx.data());
+	dequantize(n, mesh->py.data(), mesh->pos_step.y*xf.scale, mesh->pos_base.y*xf.scale+xf.offset.y, out.wy.data());
+	dequantize(n, mesh->pz.data(), mesh->pos_step.z*xf.scale, mesh->pos_base.z*xf.scale+xf.offset.z, out.wz.data());
+	dequantize(n, mesh->tu.data(), mesh->uv_step.u, mesh->uv_base.u, out.u.data());
+	dequantize(n, mesh->tv.data(), mesh->uv_step.v, mesh->uv_base.v, out.v.data());
+	float inv_c = 1.f/camera_pos.z;
+	project(n, out.wx.data(), out.wz.data(), inv_c, scale, out.sx.data());
+	project(n, out.wy.data(), out.wz.data(), inv_c, scale, out.sy.data());
+	project(n, out.wz.data(), out.wz.data(), inv_c, scale, out.sz.data());
+}
+
+// decodes n stored face normals against the light, so faces facing away are culled before any of their
+// vertices are looked up. one more flat loop: the sqrt and the no-area check would keep it from vectorizing,
+// so they wait for the faces that survive. the instance scale is uniform, it doesn't turn the normals
+static void face_facing(int n, const int16_t *__restrict fu, const int16_t *__restrict fv, Vec3f to_light, float *__restrict facing, float *__restrict len2) {
+	for (int i=0; i<n; i++) {
+		float x = fu[i]*(1.f/SNORM16_MAX), y = fv[i]*(1.f/SNORM16_MAX);
+		float z = 1-std::abs(x)-std::abs(y);
+		// unfold the lower half
+		float t = std::max(-z, 0.f);
+		x -= std::copysign(t, x);
+		y -= std::copysign(t, y);
+		facing[i] = x*to_light.x + y*to_light.y + z*to_light.z;
+		len2[i] = x*x + y*y + z*z;
+	}
+}
+
+// rasterizes the faces that have area and face the light, at the flat light level of their stored normal
+template <class Texture, class Index> static void draw_compact(const Index* index, const int16_t* fu, int nfaces, const CompactVerts& cv, const Texture& model_uv, const ImageView& image, int* zbuffer, RenderStats* stats) {
+	for (int i=0; i<nfaces; i++) {
+		if (cv.facing[i]<=0 || fu[i]==NO_FACE_NORMAL) continue;
+		float l = cv.facing[i]/std::sqrt(cv.len2[i]);
+		const Index* f = index+i*3;
+		Vec3f screen_pos[3];
+		Vec2f vt[3];
+		for (int j=0; j<3; j++) {
+			screen_pos[j] = Vec3f(cv.sx[f[j]], cv.sy[f[j]], cv.sz[f[j]]);
+			vt[j] = Vec2f(cv.u[f[j]], cv.v[f[j]]);
 		}
+		triangle(screen_pos, zbuffer, vt, model_uv, image, l, stats);
 	}
+}
 
-	// calculate scale
+// render() for a quantized mesh. every vertex goes through the transform stage once and every face is lit
+// from its stored normal, then the faces that face the light are drawn in the order the mesh keeps them
+template <class Texture> void render(const CompactMesh* mesh, const Texture& model_uv, const ImageView& image, int* zbuffer, const Instance& xf, Vec3f light_source, Vec3f camera_pos, RenderStats* stats) {
+	TRACE_SCOPE("render compact");
 	float scale = image.get_width()/2;
+	Vec3f to_light = Vec3f()-light_source;
+	CompactVerts& cv = compact_scratch;
+	{
+		TRACE_SCOPE("face setup");
+		transform_compact(mesh, xf, scale, camera_pos, cv);
+		cv.facing.resize(mesh->nfaces());
+		cv.len2.resize(mesh->nfaces());
+		face_facing(mesh->nfaces(), mesh->fu.data(), mesh->fv.data(), to_light, cv.facing.data(), cv.len2.data());
+	}
+	TRACE_SCOPE("rasterize");
+	if (mesh->wide_indices()) draw_compact(mesh->index32.data(), mesh->fu.data(), mesh->nfaces(), cv, model_uv, image, zbuffer, stats);
+	else draw_compact(mesh->index16.data(), mesh->fu.data(), mesh->nfaces(), cv, model_uv, image, zbuffer, stats);
+}
+
+// like triangle() but for translucent surfaces: fragments in front of the opaque zbuffer go into oit
+// instead of the image, and the zbuffer isn't written so whatever is behind still draws
+template <class Texture> static void translucent_triangle(Vec3f screen_pos[], const int* zbuffer, Vec2f vt[], const Texture& model_uv, OITBuffer& oit, float light_level, RenderStats* stats) {
+	int w = oit.get_width();
+	int h = oit.get_height();
+	Vec2i bboxmin = Vec2i(w-1, h-1);
+	Vec2i bboxmax = Vec2i(0, 0);
+	for (int i=0; i<3; i++) {
+		bboxmin.x = std::min(bboxmin.x, (int)screen_pos[i].x);
+		bboxmin.y = std::min(bboxmin.y, (int)screen_pos[i].y);
+		bboxmax.x = std::max(bboxmax.x, (int)screen_pos[i].x);
+		bboxmax.y = std::max(bboxmax.y, (int)screen_pos[i].y);
+	}
+	bboxmin.x = std::max(bboxmin.x, 0);
+	bboxmin.y = std::max(bboxmin.y, 0);
+	bboxmax.x = std::min(bboxmax.x, w-1);
+	bboxmax.y = std::min(bboxmax.y, h-1);
+
+	bool alpha = model_uv.get_bytespp()==TGAImage::RGBA;
+	long fragments = 0, shaded = 0;
+	Vec3f depth(screen_pos[0].z, screen_pos[1].z, screen_pos[2].z);
+	// vt is in the loader's uv order, like for triangle()
+	Vec3f tu(vt[0].u, vt[2].u, vt[1].u), tv(vt[0].v, vt[2].v, vt[1].v);
+	Vec2i P;
+	for (P.y=bboxmin.y; P.y<=bboxmax.y; P.y++) {
+		for (P.x=bboxmin.x; P.x<=bboxmax.x; P.x++) {
+			Vec3f b = corner_weights(barycentric(screen_pos, P));
+			if (b.x<0 || b.y<0 || b.z<0) continue;
+			fragments++;
+			int z = b * depth;
+			if (z<=zbuffer[P.x+P.y*w]) continue;
+			float u = b * tu;
+			float v = b * tv;
+			TGAColor color = model_uv.get(u*model_uv.get_width(), v*model_uv.get_height());
+			oit.add(P.x, P.y, z, TGAColor(color.r*light_level, color.g*light_level, color.b*light_level, alpha ? color.a : 255));
+			shaded++;
+		}
+	}
+	if (stats) {
+		stats->faces++;
+		stats->fragments += fragments;
+		stats->fragments_shaded += shaded;
+	}
+}
 
-	for (int i=0; i<model->nfaces(); i++) {
-        std::vector<Vec3i> f = model->face(i);
-		Vec3f world_pos[3];
+// adds one placement of a translucent model to oit. it's depth tested against the opaque geometry already
+// in zbuffer, so draw that first with render() and call oit.resolve() on its image after
+template <class Texture> void render_transparent(const Model* model, const Texture& model_uv, OITBuffer& oit, const int* zbuffer, const Instance& xf, Vec3f light_source, Vec3f camera_pos, RenderStats* stats) {
+	TRACE_SCOPE("render transparent");
+	int w = oit.get_width();
+	int h = oit.get_height();
+	float scale = w/2;
+	Vec3f to_light = Vec3f()-light_source;
+	VisibleFaces visible;
+	// translucent models are small next to the opaque scene, so there's no bvh walk here. faces the camera
+	// can't see are still dropped, the back of a closed shell would only double its opacity
+	visible_faces(model, 0, model->nfaces(), xf, to_light, camera_pos, w, h, Viewport(scale, scale), false, visible);
+	for (int k=0; k<visible.n; k++) {
+		const std::vector<Vec3i>& f = model->face(visible.face[k]);
+		Vec3f screen_pos[3];
 		Vec2f vt[3];
-		for (int i=0; i<3; i++) {
-			world_pos[i] = model->vert(f[i].ivert);
-			vt[i] = model->texture_vert(f[i].iuv);
+		for (int j=0; j<3; j++) {
+			Vec3f p = model->vert(f[j].ivert)*xf.scale + xf.offset;
+			float coef = 1./(1.-p.z/(float)camera_pos.z);
+			screen_pos[j] = Vec3f((p.x*coef+1)*scale, (p.y*coef+1)*scale, (p.z*coef+1)*scale);
+			vt[j] = model->texture_vert(f[j].iuv);
 		}
-		// calculate the normal. the direction of the triangle's face
-		Vec3f normal = (world_pos[1]-world_pos[0])^(world_pos[2]-world_pos[0]);
-		normal.normalize();
-		// calculate the light level by dot product. the more parallel, the brighter
-		// float light_level = normal.x*light_source.x + normal.y*light_source.y + normal.z*light_source.z;
-		float light_level = normal*(Vec3f()-light_source);
-		if (light_level<=0) continue;
+		translucent_triangle(screen_pos, zbuffer, vt, model_uv, oit, std::max(0.f, visible.light[k]), stats);
+	}
+}
 
-        rasterize(world_pos, zbuffer, vt, model_uv, image, light_level, scale, camera_pos);
-    }
+// a grid of cells on screen, front row at the bottom. each row stands further back, so the back rows come
+// out several times smaller than the front one and get coarser levels of detail
+std::vector<Instance> crowd_instances(int n, Vec3f camera_pos) {
+	int cols = std::max(1, (int)std::ceil(std::sqrt((float)n)));
+	int rows = (n+cols-1)/cols;
+	float cell = 2.f/cols;
+	std::vector<Instance> out;
+	for (int i=0; i<n; i++) {
+		int c = i%cols, r = i/cols;
+		float z = -4.f*r/cols;
+		// undo the perspective divide so the centre lands in the middle of its cell
+		float coef = 1.f-z/camera_pos.z;
+		Vec3f screen((c+.5f)*cell-1, (r+.5f)*2.f/rows-1, 0);
+		out.push_back(Instance(Vec3f(screen.x*coef, screen.y*coef, z), .45f*cell));
+	}
+	return out;
+}
 
+// draws every instance with the level of detail that fits its size on screen
+template <class Texture> void render_instances(LODChain& lods, const std::vector<Instance>& instances, const Texture& model_uv, const ImageView& image, Vec3f light_source, Vec3f camera_pos, RenderStats* stats) {
+	int w = image.get_width();
+	int h = image.get_height();
+	int* zbuffer = new int[w*h];
+	clear_zbuffer(zbuffer, w, h);
+	float scale = w/2;
+	for (size_t i=0; i<instances.size(); i++) {
+		float area = screen_area(lods.level(0), instances[i], scale, camera_pos);
+		Model* model = lods.level(lods.select(area));
+		render(model, model_uv, image, zbuffer, instances[i], light_source, camera_pos, stats);
+	}
 	delete[] zbuffer;
 }
 
+// ------------------------- per-pixel lighting -------------------------
+
+const int SHADE_BATCH = 16; // fragments lit together. a multiple of the simd width so the loops vectorize cleanly
+const float PHONG_AMBIENT = 5;
+const float PHONG_SPECULAR = .6;
+
+// one face as the phong path sees it. everything is in the model's real corner order, not the swapped uv order
+struct PhongTriangle {
+	Vec3f screen[3];
+	Vec3f world[3];
+	Vec2f uv[3];
+	Vec3f t[3], b[3], n[3]; // tangent frames
+};
+
+// fragments that passed the depth test and are waiting to be lit. w0..w2 are the corner weights
+struct FragmentBatch {
+	int n;
+	int x[SHADE_BATCH], y[SHADE_BATCH];
+	float w0[SHADE_BATCH], w1[SHADE_BATCH], w2[SHADE_BATCH];
+};
+
+// lights a batch of fragments. interpolation and lighting run on whole batches as plain float arrays so
+// the compiler turns them into simd, only the texture fetches and pow() go one fragment at a time
+template <class Texture> static void shade_batch(const PhongTriangle& tri, FragmentBatch& batch, const Material<Texture>& mat, const ImageView& image, Vec3f to_light, Vec3f camera_pos) {
+	const int n = batch.n;
+	// unused lanes get zero weights so they compute harmless garbage
+	for (int k=n; k<SHADE_BATCH; k++) batch.w0[k] = batch.w1[k] = batch.w2[k] = 0;
+
+	float u[SHADE_BATCH], v[SHADE_BATCH];
+	float px[SHADE_BATCH], py[SHADE_BATCH], pz[SHADE_BATCH];
+	float tx[SHADE_BATCH], ty[SHADE_BATCH], tz[SHADE_BATCH];
+	float bx[SHADE_BATCH], by[SHADE_BATCH], bz[SHADE_BATCH];
+	float nx[SHADE_BATCH], ny[SHADE_BATCH], nz[SHADE_BATCH];
+	for (int k=0; k<SHADE_BATCH; k++) {
+		float a = batch.w0[k], b = batch.w1[k], c = batch.w2[k];
+		u[k] = a*tri.uv[0].u + b*tri.uv[1].u + c*tri.uv[2].u;
+		v[k] = a*tri.uv[0].v + b*tri.uv[1].v + c*tri.uv[2].v;
+		px[k] = a*tri.world[0].x + b*tri.world[1].x + c*tri.world[2].x;
+		py[k] = a*tri.world[0].y + b*tri.world[1].y + c*tri.world[2].y;
+		pz[k] = a*tri.world[0].z + b*tri.world[1].z + c*tri.world[2].z;
+		tx[k] = a*tri.t[0].x + b*tri.t[1].x + c*tri.t[2].x;
+		ty[k] = a*tri.t[0].y + b*tri.t[1].y + c*tri.t[2].y;
+		tz[k] = a*tri.t[0].z + b*tri.t[1].z + c*tri.t[2].z;
+		bx[k] = a*tri.b[0].x + b*tri.b[1].x + c*tri.b[2].x;
+		by[k] = a*tri.b[0].y + b*tri.b[1].y + c*tri.b[2].y;
+		bz[k] = a*tri.b[0].z + b*tri.b[1].z + c*tri.b[2].z;
+		nx[k] = a*tri.n[0].x + b*tri.n[1].x + c*tri.n[2].x;
+		ny[k] = a*tri.n[0].y + b*tri.n[1].y + c*tri.n[2].y;
+		nz[k] = a*tri.n[0].z + b*tri.n[1].z + c*tri.n[2].z;
+	}
+
+	// texture fetches
+	float cr[SHADE_BATCH], cg[SHADE_BATCH], cb[SHADE_BATCH];
+	float mx[SHADE_BATCH], my[SHADE_BATCH], mz[SHADE_BATCH];
+	float sp[SHADE_BATCH];
+	for (int k=0; k<SHADE_BATCH; k++) {
+		cr[k] = cg[k] = cb[k] = 255;
+		mx[k] = 0; my[k] = 0; mz[k] = 1;
+		sp[k] = 0;
+	}
+	if (mat.diffuse) {
+		int tw = mat.diffuse->get_width(), th = mat.diffuse->get_height();
+		for (int k=0; k<n; k++) {
+			TGAColor c = mat.diffuse->get(u[k]*tw, v[k]*th);
+			cr[k] = c.r; cg[k] = c.g; cb[k] = c.b;
+		}
+	}
+	if (mat.normal_map) {
+		int tw = mat.normal_map->get_width(), th = mat.normal_map->get_height();
+		for (int k=0; k<n; k++) {
+			TGAColor c = mat.normal_map->get(u[k]*tw, v[k]*th);
+			mx[k] = c.r*(2/255.f)-1;
+			my[k] = c.g*(2/255.f)-1;
+			mz[k] = c.b*(2/255.f)-1;
+		}
+	}
+	if (mat.specular) {
+		int tw = mat.specular->get_width(), th = mat.specular->get_height();
+		for (int k=0; k<n; k++) {
+			sp[k] = mat.specular->get(u[k]*tw, v[k]*th).raw[0];
+		}
+	}
+
+	// diffuse and the cosine between the reflected light and the camera
+	float diff[SHADE_BATCH], rv[SHADE_BATCH];
+	for (int k=0; k<SHADE_BATCH; k++) {
+		// the normal map's vector is in the (t, b, n) frame
+		float Nx = tx[k]*mx[k] + bx[k]*my[k] + nx[k]*mz[k];
+		float Ny = ty[k]*mx[k] + by[k]*my[k] + ny[k]*mz[k];
+		float Nz = tz[k]*mx[k] + bz[k]*my[k] + nz[k]*mz[k];
+		float inv = 1.f/std::sqrt(Nx*Nx + Ny*Ny + Nz*Nz + 1e-20f);
+		Nx *= inv; Ny *= inv; Nz *= inv;
+		float nl = Nx*to_light.x + Ny*to_light.y + Nz*to_light.z;
+		float Vx = camera_pos.x-px[k], Vy = camera_pos.y-py[k], Vz = camera_pos.z-pz[k];
+		inv = 1.f/std::sqrt(Vx*Vx + Vy*Vy + Vz*Vz + 1e-20f);
+		float Rx = Nx*(2*nl)-to_light.x, Ry = Ny*(2*nl)-to_light.y, Rz = Nz*(2*nl)-to_light.z;
+		float r = (Rx*Vx + Ry*Vy + Rz*Vz)*inv;
+		diff[k] = nl>0 ? nl : 0;
+		rv[k] = nl>0 && r>0 ? r : 0;
+	}
+	for (int k=0; k<n; k++) {
+		rv[k] = rv[k]>0 ? std::pow(rv[k], std::max(1.f, sp[k])) : 0;
+	}
+	// fragments are inside the image already, so they go straight into the view
+	int bpp = image.get_bytespp();
+	for (int k=0; k<n; k++) {
+		float l = diff[k] + PHONG_SPECULAR*rv[k];
+		float r = std::min(255.f, PHONG_AMBIENT + cr[k]*l);
+		float g = std::min(255.f, PHONG_AMBIENT + cg[k]*l);
+		float b = std::min(255.f, PHONG_AMBIENT + cb[k]*l);
+		TGAColor c(r, g, b, 255);
+		memcpy(image.pixel(batch.x[k], batch.y[k]), c.raw, bpp);
+	}
+	batch.n = 0;
+}
+
+// like triangle(), but queues the visible fragments for shade_batch() instead of texturing them one by one
+template <class Texture> static void phong_triangle(const PhongTriangle& tri, int* zbuffer, const Material<Texture>& mat, const ImageView& image, Vec3f to_light, Vec3f camera_pos, RenderStats* stats) {
+	int w = image.get_width();
+	int h = image.get_height();
+	Vec3f screen_pos[3] = {tri.screen[0], tri.screen[1], tri.screen[2]};
+
+	Vec2i bboxmin = Vec2i(w-1, h-1);
+	Vec2i bboxmax = Vec2i(0, 0);
+	for (int i=0; i<3; i++) {
+		if (screen_pos[i].x < bboxmin.x) bboxmin.x = screen_pos[i].x;
+		if (screen_pos[i].y < bboxmin.y) bboxmin.y = screen_pos[i].y;
+		if (screen_pos[i].x > bboxmax.x) bboxmax.x = screen_pos[i].x;
+		if (screen_pos[i].y > bboxmax.y) bboxmax.y = screen_pos[i].y;
+	}
+	if (bboxmin.x<0) bboxmin.x=0;
+	if (bboxmin.y<0) bboxmin.y=0;
+	if (bboxmax.x>w-1) bboxmax.x=w-1;
+	if (bboxmax.y>h-1) bboxmax.y=h-1;
+
+	FragmentBatch batch;
+	batch.n = 0;
+	long fragments = 0, shaded = 0;
+	Vec3f depth(screen_pos[0].z, screen_pos[1].z, screen_pos[2].z);
+	Vec2i P;
+	for (P.y=bboxmin.y; P.y<=bboxmax.y; P.y++) {
+		for (P.x=bboxmin.x; P.x<=bboxmax.x; P.x++) {
+			Vec3f b = corner_weights(barycentric(screen_pos, P));
+			if (b.x<0 || b.y<0 || b.z<0) continue;
+			fragments++;
+			int z = b * depth;
+			if (z<=zbuffer[P.x+P.y*w]) continue;
+			zbuffer[P.x+P.y*w] = z;
+			int k = batch.n++;
+			batch.x[k] = P.x;
+			batch.y[k] = P.y;
+			batch.w0[k] = b.x;
+			batch.w1[k] = b.y;
+			batch.w2[k] = b.z;
+			if (batch.n==SHADE_BATCH) shade_batch(tri, batch, mat, image, to_light, camera_pos);
+			shaded++;
+		}
+	}
+	if (batch.n>0) shade_batch(tri, batch, mat, image, to_light, camera_pos);
+	if (stats) {
+		stats->faces++;
+		stats->fragments += fragments;
+		stats->fragments_shaded += shaded;
+	}
+}
+
+// gathers face i with its tangent frames and rasterizes it with per-pixel lighting. visible_faces() has
+// already dropped it if the camera can't see it
+template <class Texture> static void phong_face(const Model* model, int i, const Instance& xf, int* zbuffer, const Material<Texture>& mat, const ImageView& image, Vec3f to_light, float scale, Vec3f camera_pos, RenderStats* stats) {
+	const std::vector<Vec3i>& f = model->face(i);
+	PhongTriangle tri;
+	for (int j=0; j<3; j++) {
+		tri.world[j] = model->vert(f[j].ivert)*xf.scale + xf.offset;
+	}
+
+	int iuv[3] = {f[0].iuv, f[2].iuv, f[1].iuv}; // undo the loader's swap
+	for (int j=0; j<3; j++) {
+		tri.uv[j] = model->texture_vert(iuv[j]);
+		int k = model->corner_frame(i, j);
+		tri.t[j] = model->tangent(k);
+		tri.b[j] = model->bitangent(k);
+		tri.n[j] = model->frame_normal(k);
+		float coef = 1./(1.-tri.world[j].z/(float)camera_pos.z);
+		tri.screen[j].x = (tri.world[j].x*coef+1)*scale;
+		tri.screen[j].y = (tri.world[j].y*coef+1)*scale;
+		tri.screen[j].z = (tri.world[j].z*coef+1)*scale;
+	}
+	phong_triangle(tri, zbuffer, mat, image, to_light, camera_pos, stats);
+}
+
+// draws one placement of the model with per-pixel lighting into image and zbuffer without clearing either
+template <class Texture> void render_phong(const Model* model, const Material<Texture>& mat, const ImageView& image, int* zbuffer, const Instance& xf, Vec3f light_source, Vec3f camera_pos, RenderStats* stats) {
+	TRACE_SCOPE("render phong");
+	float scale = image.get_width()/2;
+	Vec3f to_light = Vec3f()-light_source;
+	VisibleFaces visible;
+	// the normal map can light a face that faces away from the light, so only drop faces the camera can't see
+	auto draw_faces = [&](int first, int n) {
+		{
+			TRACE_SCOPE("face setup");
+			visible_faces(model, first, n, xf, to_light, camera_pos, image.get_width(), image.get_height(), Viewport(scale, scale), false, visible);
+		}
+		TRACE_SCOPE("shade");
+		for (int k=0; k<visible.n; k++) {
+			phong_face(model, visible.face[k], xf, zbuffer, mat, image, to_light, scale, camera_pos, stats);
+		}
+	};
+
+	if (model->nbvh_nodes()>0) {
+		// the cones are built for a direction, not a point, so they can't cull against the camera
+		render_bvh(model, xf, zbuffer, image.get_width(), image.get_height(), Vec3f(), Viewport(scale, scale), camera_pos, stats, draw_faces);
+	} else if (model->nmeshlets()>0) {
+		std::vector<int> order = meshlet_order(model, (camera_pos-xf.offset)*(1.f/xf.scale));
+		for (size_t k=0; k<order.size(); k++) {
+			Meshlet m = model->meshlet(order[k]);
+			draw_faces(m.first_face, m.nfaces);
+		}
+	} else {
+		draw_faces(0, model->nfaces());
+	}
+}
+
+// draws the model with per-pixel lighting from the material's normal and specular maps
+template <class Texture> void render_phong(const Model* model, const Material<Texture>& mat, const ImageView& image, Vec3f light_source, Vec3f camera_pos, RenderStats* stats) {
+	int w = image.get_width();
+	int h = image.get_height();
+	int* zbuffer = new int[w*h];
+	clear_zbuffer(zbuffer, w, h);
+
+	render_phong(model, mat, image, zbuffer, Instance(), light_source, camera_pos, stats);
+
+	delete[] zbuffer;
+}
+
+// the rasterizer is a template over the texture type, build it for the ones we have
+#define INSTANTIATE_RENDERER(Texture) \
+	template void triangle<Texture>(Vec3f[], int*, Vec2f[], const Texture&, const ImageView&, float, RenderStats*, float, Vec2i); \
+	template void rasterize<Texture>(Vec3f[], int*, Vec2f[], const Texture&, const ImageView&, float, float, Vec3f, RenderStats*); \
+	template void render<Texture>(const Model*, const Texture&, const ImageView&, int*, const Instance&, Vec3f, Vec3f, RenderStats*); \
+	template void render_viewport<Texture>(const Model*, const Texture&, const ImageView&, int*, const Instance&, Vec3f, Vec3f, const Viewport&, RenderStats*); \
+	template void render<Texture>(const Model*, const Texture&, const ImageView&, Vec3f, Vec3f, RenderStats*); \
+	template void render<Texture>(const CompactMesh*, const Texture&, const ImageView&, int*, const Instance&, Vec3f, Vec3f, RenderStats*); \
+	template void render_instances<Texture>(LODChain&, const std::vector<Instance>&, const Texture&, const ImageView&, Vec3f, Vec3f, RenderStats*); \
+	template void render_phong<Texture>(const Model*, const Material<Texture>&, const ImageView&, int*, const Instance&, Vec3f, Vec3f, RenderStats*); \
+	template void render_phong<Texture>(const Model*, const Material<Texture>&, const ImageView&, Vec3f, Vec3f, RenderStats*); \
+	template void render_transparent<Texture>(const Model*, const Texture&, OITBuffer&, const int*, const Instance&, Vec3f, Vec3f, RenderStats*);
+INSTANTIATE_RENDERER(TGAImage)
+INSTANTIATE_RENDERER(BCTexture)
+
 // ----------------------------------------------------------------------
 // ------------------ Other/Outdated Functions --------------------------
 // ----------------------------------------------------------------------
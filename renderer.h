@@ -4,14 +4,83 @@
 #ifndef TATE_RENDERER_H
 #define TATE_RENDERER_H
 
+#include <vector>
 #include "tgaimage.h"
+#include "imageview.h"
 #include "geometry.h"
 #include "model.h"
 
-Vec3f barycentric(Vec3f* pts, Vec2i P);
-void triangle(Vec3f pts[], int* zbuffer, Vec2f vt[], TGAImage& model_uv, TGAImage& image, float light_level);
-void rasterize(Vec3f pts[], int* zbuffer, Vec2f vt[], TGAImage& model_uv, TGAImage& image, float light_level, float scale, Vec3f camera_pos);
-void render(Model* model, TGAImage& model_uv, TGAImage& image, Vec3f light_source, Vec3f camera_pos);
+// counters filled in by render() when it is given somewhere to put them
+struct RenderStats {
+	long faces;              // faces sent to the rasterizer
+	long fragments;          // pixels found inside a triangle
+	long fragments_shaded;   // pixels that passed the depth test and were textured
+	long texel_line_changes; // texture fetches that hit a different 64 byte line than the fetch before
+	long meshlets_drawn;
+	long meshlets_culled;    // rejected whole by the bvh (off screen, facing away from the light or hidden)
+	RenderStats() : faces(0), fragments(0), fragments_shaded(0), texel_line_changes(0), meshlets_drawn(0), meshlets_culled(0) {}
+};
+
+// where a model sits in the scene: world position = vert*scale + offset
+struct Instance {
+	Vec3f offset;
+	float scale;
+	Instance() : offset(), scale(1) {}
+	Instance(Vec3f offset, float scale) : offset(offset), scale(scale) {}
+};
+
+// maps for render_phong(). normal_map is in tangent space, specular holds the exponent. any can be NULL
+template <class Texture> struct Material {
+	const Texture* diffuse;
+	const Texture* normal_map;
+	const Texture* specular;
+	Material(const Texture* diffuse=NULL, const Texture* normal_map=NULL, const Texture* specular=NULL) : diffuse(diffuse), normal_map(normal_map), specular(specular) {}
+};
+
+// how render_viewport() projects: x and y land at (p*coef+1)*scale and depth at (p.z*coef+1)*depth_scale,
+// which is what render() does with both at w/2. the image drawn into is the window of that projection whose
+// bottom left pixel is x0, y0, so a tile of a bigger picture can be rendered on its own and come out the
+// same as that part of the whole
+struct Viewport {
+	float scale, depth_scale;
+	int x0, y0;
+	Viewport(float scale, float depth_scale, int x0=0, int y0=0) : scale(scale), depth_scale(depth_scale), x0(x0), y0(y0) {}
+};
+
+// screen space bounds of something, inclusive
+struct ScreenRect {
+	int x0, y0, x1, y1;
+	int zmax; // nearest depth, same units as the zbuffer
+};
+
+class LODChain;
+class CompactMesh;
+class OITBuffer;
+
+// the rasterizer samples textures through get(x, y), get_width() and get_height(). it's built for
+// TGAImage and BCTexture, see the bottom of renderer.cpp.
+// it draws into an ImageView, which a TGAImage converts to, so it can also draw through a flipped view
+
+Vec3f barycentric(Vec3f* pts, Vec2i P, float min_area=1);
+// origin is the screen position of image's first pixel, for drawing one tile of a bigger picture
+template <class Texture> void triangle(Vec3f pts[], int* zbuffer, Vec2f vt[], const Texture& model_uv, const ImageView& image, float light_level, RenderStats* stats=NULL, float min_area=1, Vec2i origin=Vec2i());
+template <class Texture> void rasterize(Vec3f pts[], int* zbuffer, Vec2f vt[], const Texture& model_uv, const ImageView& image, float light_level, float scale, Vec3f camera_pos, RenderStats* stats=NULL);
+void clear_zbuffer(int* zbuffer, int w, int h);
+float screen_area(const Model* model, const Instance& xf, float scale, Vec3f camera_pos);
+bool screen_rect(const Model* model, const Instance& xf, int w, int h, Vec3f camera_pos, ScreenRect& r);
+// n placements of a model about 2 units across, in rows going back from the camera, for render_instances()
+std::vector<Instance> crowd_instances(int n, Vec3f camera_pos);
+template <class Texture> void render(const Model* model, const Texture& model_uv, const ImageView& image, int* zbuffer, const Instance& xf, Vec3f light_source, Vec3f camera_pos, RenderStats* stats=NULL);
+template <class Texture> void render(const Model* model, const Texture& model_uv, const ImageView& image, Vec3f light_source, Vec3f camera_pos, RenderStats* stats=NULL);
+// render() through a Viewport. a smaller image with scale w/(2*step) samples every step-th pixel of the w
+// wide image, and keeping depth_scale at w/2 gives its depth tests the full image's precision. an origin
+// renders one tile of the picture
+template <class Texture> void render_viewport(const Model* model, const Texture& model_uv, const ImageView& image, int* zbuffer, const Instance& xf, Vec3f light_source, Vec3f camera_pos, const Viewport& vp, RenderStats* stats=NULL);
+template <class Texture> void render(const CompactMesh* mesh, const Texture& model_uv, const ImageView& image, int* zbuffer, const Instance& xf, Vec3f light_source, Vec3f camera_pos, RenderStats* stats=NULL);
+template <class Texture> void render_phong(const Model* model, const Material<Texture>& mat, const ImageView& image, int* zbuffer, const Instance& xf, Vec3f light_source, Vec3f camera_pos, RenderStats* stats=NULL);
+template <class Texture> void render_phong(const Model* model, const Material<Texture>& mat, const ImageView& image, Vec3f light_source, Vec3f camera_pos, RenderStats* stats=NULL);
+template <class Texture> void render_transparent(const Model* model, const Texture& model_uv, OITBuffer& oit, const int* zbuffer, const Instance& xf, Vec3f light_source, Vec3f camera_pos, RenderStats* stats=NULL);
+template <class Texture> void render_instances(LODChain& lods, const std::vector<Instance>& instances, const Texture& model_uv, const ImageView& image, Vec3f light_source, Vec3f camera_pos, RenderStats* stats=NULL);
 
 void line(int x0, int y0, int x1, int y1, TGAImage& image, const TGAColor& color);
 void line(Vec2i v0, Vec2i v1, TGAImage& image, const TGAColor& color);
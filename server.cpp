@@ -0,0 +1,318 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <memory>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "tgaimage.h"
+#include "geometry.h"
+#include "model.h"
+#include "renderer.h"
+#include "assets.h"
+#include "threadpool.h"
+#include "progressive.h"
+#include "trace.h"
+#include "server.h"
+
+typedef std::chrono::steady_clock Clock;
+
+RenderJob::RenderJob() : id(), model("obj/african_head/african_head.obj"), texture("obj/african_head/african_head_diffuse.tga"),
+	output(), camera(0, 0, 3), light(0, 0, -1), width(1000), height(1000), compress(false), budget_ms(0) {
+}
+
+static bool parse_vec3(const std::string& s, Vec3f& v) {
+	char c1, c2;
+	std::istringstream iss(s);
+	return (iss >> v.x >> c1 >> v.y >> c2 >> v.z) && c1==',' && c2==',';
+}
+
+bool parse_job(const std::string& line, RenderJob& job, std::string& error) {
+	std::istringstream iss(line);
+	std::string token;
+	while (iss >> token) {
+		size_t eq = token.find('=');
+		if (eq==std::string::npos) { error = "expected key=value, got " + token; return false; }
+		std::string key = token.substr(0, eq);
+		std::string value = token.substr(eq+1);
+		bool ok = true;
+		if (key=="id") job.id = value;
+		else if (key=="model") job.model = value;
+		else if (key=="texture") job.texture = value;
+		else if (key=="output") job.output = value;
+		else if (key=="camera") ok = parse_vec3(value, job.camera);
+		else if (key=="light") ok = parse_vec3(value, job.light) && job.light.norm()>0;
+		else if (key=="width") ok = (job.width = atoi(value.c_str()))>0 && job.width<=JOB_MAX_SIDE;
+		else if (key=="height") ok = (job.height = atoi(value.c_str()))>0 && job.height<=JOB_MAX_SIDE;
+		else if (key=="compress") job.compress = value=="1";
+		else if (key=="budget") ok = (job.budget_ms = atof(value.c_str()))>=0;
+		else { error = "unknown key " + key; return false; }
+		if (!ok) { error = "bad value for " + key; return false; }
+	}
+	if (job.output.empty()) { error = "missing output"; return false; }
+	// the renderer takes a unit light, a longer one would over-brighten and throw off the meshlet cone cull
+	job.light.normalize();
+	return true;
+}
+
+// request latencies, measured from when the job line arrived to when its output was written
+class ServerStats {
+	std::mutex mutex;
+	std::vector<double> latencies;
+	int failed;
+	Clock::time_point start;
+public:
+	ServerStats() : mutex(), latencies(), failed(0), start(Clock::now()) {}
+	void record(double ms, bool ok) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (ok) latencies.push_back(ms);
+		else failed++;
+	}
+	std::string report() {
+		std::lock_guard<std::mutex> lock(mutex);
+		double elapsed = std::chrono::duration<double>(Clock::now()-start).count();
+		std::vector<double> sorted = latencies;
+		std::sort(sorted.begin(), sorted.end());
+		std::ostringstream s;
+		s << "jobs " << sorted.size() << " failed " << failed << " elapsed " << elapsed << "s"
+		  << " jobs/s " << (elapsed>0 ? sorted.size()/elapsed : 0);
+		if (!sorted.empty()) {
+			s << " latency ms p50 " << sorted[sorted.size()/2] << " p95 " << sorted[sorted.size()*95/100]
+			  << " max " << sorted.back();
+		}
+		return s.str();
+	}
+};
+
+static std::string cache_report(AssetCache& cache) {
+	AssetCache::Stats cs = cache.stats();
+	std::ostringstream s;
+	s << "cache hits " << cs.hits << " misses " << cs.misses << " evictions " << cs.evictions
+	  << " resident_mb " << cs.resident_bytes/(1024.*1024.);
+	return s.str();
+}
+
+// writes view over path in one step, through a temporary file next to it, so a client never reads half of it
+static bool replace_file(const ConstImageView& view, const std::string& path) {
+	size_t dot = path.rfind('.');
+	std::string tmp = dot==std::string::npos || path.find('/', dot)!=std::string::npos ? path + ".part" : path.substr(0, dot) + ".part" + path.substr(dot);
+	if (!write_file(view, tmp.c_str())) return false;
+	if (rename(tmp.c_str(), path.c_str())!=0) {
+		unlink(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+// on_pass(step) is called after each coarse to fine pass is written, when the job has a budget
+template <class Texture> static std::string run_job(const RenderJob& job, const Model* model, std::shared_ptr<const Texture> texture, std::function<void(int)> on_pass) {
+	if (!texture) return "can't load texture " + job.texture;
+	TGAImage image = TGAImage(job.width, job.height, TGAImage::RGB);
+	if (job.budget_ms>0) {
+		bool written = true;
+		render_progressive(model, *texture, job.width, job.height, job.light, job.camera, job.budget_ms, [&](const ConstImageView& frame, int step) {
+			upscale_nearest(frame, step, image);
+			written = replace_file(ConstImageView(image).flipped(), job.output);
+			if (written) on_pass(step);
+			return written;
+		});
+		return written ? "" : "can't write " + job.output;
+	}
+	render(model, *texture, image, job.light, job.camera);
+	if (!write_file(ConstImageView(image).flipped(), job.output.c_str())) return "can't write " + job.output;
+	return "";
+}
+
+template <class Texture> static std::string run_job(const RenderJob& job, AssetCache& cache, std::shared_future<std::shared_ptr<const Texture>> texture, std::function<void(int)> on_pass) {
+	ModelHandle model = cache.model(job.model);
+	if (!model) return "can't load model " + job.model;
+	return run_job(job, model.get(), texture.get(), on_pass);
+}
+
+// the texture loads on loaders while this thread loads the model. a job that throws, say bad_alloc for its
+// buffers, fails on its own rather than taking the pool thread and the server down with it
+static std::string run_job(const RenderJob& job, AssetCache& cache, ThreadPool& loaders, std::function<void(int)> on_pass) {
+	try {
+		if (job.compress) return run_job<BCTexture>(job, cache, cache.compressed_texture_async(job.texture, loaders), on_pass);
+		return run_job<TGAImage>(job, cache, cache.texture_async(job.texture, loaders), on_pass);
+	} catch (const std::exception& e) {
+		return std::string("can't render: ") + e.what();
+	}
+}
+
+// handles one protocol line. jobs go to the pool and reply when they finish, commands reply straight away.
+// returns false for "quit"
+static bool handle_line(const std::string& line, int seq, ThreadPool& pool, AssetCache& cache, ThreadPool& loaders, ServerStats& stats,
+		std::function<void(const std::string&)> reply) {
+	if (line.empty() || line[0]=='#') return true;
+	if (line=="stats") { reply("stats " + stats.report() + " " + cache_report(cache)); return true; }
+	if (line=="quit") return false;
+	if (line=="trace on" || line=="trace off") {
+		trace_enable(line=="trace on");
+		reply(line);
+		return true;
+	}
+	if (!line.compare(0, 6, "trace ")) {
+		std::string path = line.substr(6);
+		reply(trace_dump(path.c_str()) ? "trace " + path : "trace error can't write " + path);
+		return true;
+	}
+
+	Clock::time_point received = Clock::now();
+	RenderJob job;
+	job.id = std::to_string(seq);
+	std::string error;
+	if (!parse_job(line, job, error)) {
+		stats.record(0, false);
+		reply(job.id + " error " + error);
+		return true;
+	}
+	pool.submit([job, received, &cache, &loaders, &stats, reply]() {
+		TRACE_SCOPE("job");
+		std::string error = run_job(job, cache, loaders, [&job, received, &reply](int step) {
+			double ms = std::chrono::duration<double, std::milli>(Clock::now()-received).count();
+			reply(job.id + " pass " + std::to_string(step) + " " + job.output + " " + std::to_string(ms));
+		});
+		double ms = std::chrono::duration<double, std::milli>(Clock::now()-received).count();
+		stats.record(ms, error.empty());
+		if (error.empty()) reply(job.id + " ok " + job.output + " " + std::to_string(ms));
+		else reply(job.id + " error " + error);
+	});
+	return true;
+}
+
+// reads jobs from stdin until eof or "quit" and replies on stdout. prints the stats to stderr at the end
+int serve_stdin(int nworkers, size_t cache_budget) {
+	AssetCache cache(cache_budget);
+	ThreadPool loaders(ASSET_LOADERS);
+	ServerStats stats;
+	ThreadPool pool(nworkers);
+	std::mutex out_mutex;
+	std::function<void(const std::string&)> reply = [&out_mutex](const std::string& s) {
+		std::lock_guard<std::mutex> lock(out_mutex);
+		std::cout << s << std::endl;
+	};
+	std::cerr << "# serving stdin with " << pool.size() << " workers" << std::endl;
+	std::string line;
+	int seq = 0;
+	while (std::getline(std::cin, line)) {
+		if (!handle_line(line, seq++, pool, cache, loaders, stats, reply)) break;
+	}
+	pool.wait();
+	std::cerr << "# " << stats.report() << " " << cache_report(cache) << std::endl;
+	return 0;
+}
+
+// a client of the socket server. closed once the reader and all of its jobs are done with it
+struct Connection {
+	int fd;
+	std::mutex write_mutex;
+	Connection(int fd) : fd(fd), write_mutex() {}
+	~Connection() { close(fd); }
+	void send(const std::string& s) {
+		std::lock_guard<std::mutex> lock(write_mutex);
+		std::string msg = s + "\n";
+		size_t sent = 0;
+		while (sent<msg.size()) {
+			ssize_t n = ::send(fd, msg.data()+sent, msg.size()-sent, MSG_NOSIGNAL);
+			if (n<=0) return;
+			sent += n;
+		}
+	}
+};
+
+// listens on a unix socket, every connection can send any number of job lines. "quit" from any
+// client stops the server once running jobs are done
+int serve_socket(const char *path, int nworkers, size_t cache_budget) {
+	int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (listen_fd<0 || strlen(path)>=sizeof(addr.sun_path)) {
+		std::cerr << "can't create socket " << path << "\n";
+		return 1;
+	}
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path)-1);
+	unlink(path);
+	if (bind(listen_fd, (sockaddr *)&addr, sizeof(addr))!=0 || listen(listen_fd, 64)!=0) {
+		std::cerr << "can't listen on " << path << ": " << strerror(errno) << "\n";
+		close(listen_fd);
+		return 1;
+	}
+
+	AssetCache cache(cache_budget);
+	ThreadPool loaders(ASSET_LOADERS);
+	ServerStats stats;
+	ThreadPool pool(nworkers);
+	// a reader thread per connection, detached so a closed connection doesn't leave a thread behind. the
+	// count is how quit knows they're all gone
+	std::mutex clients_mutex;
+	std::condition_variable readers_done;
+	std::set<int> clients;
+	int nreaders = 0;
+	std::cerr << "# serving " << path << " with " << pool.size() << " workers" << std::endl;
+
+	for (;;) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd<0) break; // listen_fd was shut down by "quit"
+		{
+			std::lock_guard<std::mutex> lock(clients_mutex);
+			clients.insert(fd);
+			nreaders++;
+		}
+		std::thread([fd, listen_fd, &pool, &cache, &loaders, &stats, &clients_mutex, &readers_done, &clients, &nreaders]() {
+			trace_thread_name("reader");
+			std::shared_ptr<Connection> conn = std::make_shared<Connection>(fd);
+			std::function<void(const std::string&)> reply = [conn](const std::string& s) { conn->send(s); };
+			std::string pending;
+			char buf[4096];
+			int seq = 0;
+			bool quit = false;
+			ssize_t n;
+			while (!quit && (n = read(fd, buf, sizeof(buf)))>0) {
+				pending.append(buf, n);
+				size_t nl;
+				while (!quit && (nl = pending.find('\n'))!=std::string::npos) {
+					std::string line = pending.substr(0, nl);
+					pending.erase(0, nl+1);
+					if (!line.empty() && line[line.size()-1]=='\r') line.erase(line.size()-1);
+					quit = !handle_line(line, seq++, pool, cache, loaders, stats, reply);
+				}
+			}
+			{
+				std::lock_guard<std::mutex> lock(clients_mutex);
+				clients.erase(fd);
+				if (quit) {
+					// wake up accept() and every other reader
+					shutdown(listen_fd, SHUT_RDWR);
+					for (std::set<int>::iterator it=clients.begin(); it!=clients.end(); ++it) shutdown(*it, SHUT_RD);
+				}
+				if (--nreaders==0) readers_done.notify_all();
+			}
+		}).detach();
+	}
+	{
+		std::unique_lock<std::mutex> lock(clients_mutex);
+		readers_done.wait(lock, [&nreaders] { return nreaders==0; });
+	}
+	pool.wait();
+	close(listen_fd);
+	unlink(path);
+	std::cerr << "# " << stats.report() << " " << cache_report(cache) << std::endl;
+	return 0;
+}
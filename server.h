@@ -0,0 +1,41 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_SERVER_H
+#define TATE_SERVER_H
+
+#include <string>
+#include <cstddef>
+#include "geometry.h"
+
+// one line of the server protocol, whitespace separated key=value pairs:
+// id=<token> model=<obj> texture=<tga|qoi> camera=x,y,z light=x,y,z width=<px> height=<px> compress=<0|1> budget=<ms> output=<tga|qoi>
+// every key but output has a default, light is any nonzero direction. the reply is "<id> ok <output> <ms>" or "<id> error <message>".
+// with a budget the image is rendered coarse to fine, each pass replaces output as soon as it's done and
+// is announced with "<id> pass <step> <output> <ms>" before the ok.
+// besides jobs: "stats", "trace on" and "trace off" to start and stop recording stage timings (see
+// trace.h), "trace <path>" to write out what's been recorded so far, answered with "trace <path>", and "quit"
+
+// widest or tallest image a job can ask for. pixel indices and the w*h*4 byte zbuffer are ints, 16384 keeps
+// them in range where the tga limit of 0xffff wouldn't
+const int JOB_MAX_SIDE = 16384;
+
+struct RenderJob {
+	std::string id;
+	std::string model;
+	std::string texture;
+	std::string output;
+	Vec3f camera;
+	Vec3f light;
+	int width;
+	int height;
+	bool compress; // sample a block compressed copy of the texture
+	double budget_ms; // 0 renders in one go
+	RenderJob();
+};
+
+bool parse_job(const std::string& line, RenderJob& job, std::string& error);
+int serve_stdin(int nworkers, size_t cache_budget);
+int serve_socket(const char *path, int nworkers, size_t cache_budget);
+
+#endif // TATE_SERVER_H
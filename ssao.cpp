@@ -0,0 +1,245 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "tgaimage.h"
+#include "imageview.h"
+#include "geometry.h"
+#include "threadpool.h"
+#include "trace.h"
+#include "ssao.h"
+
+const float SSAO_EMPTY = -1e6f; // z of pixels nothing was drawn on, far enough to never occlude
+const int SSAO_BAND = 16;       // rows per task
+
+// planes of floats at the resolution ao is computed at, padded by pad pixels on every side so the sample
+// and blur loops never need to clip
+struct Planes {
+	int w, h, pad, stride;
+	float* row(std::vector<float>& v, int y) const { return v.data()+(size_t)(y+pad)*stride+pad; }
+	const float* row(const std::vector<float>& v, int y) const { return v.data()+(size_t)(y+pad)*stride+pad; }
+	size_t size() const { return (size_t)stride*(h+2*pad); }
+};
+
+// view positions, undoing rasterize()'s projection: screen = (p*coef+1)*scale with coef = 1/(1-p.z/c).
+// pixels nothing was drawn on (and the padding) get SSAO_EMPTY for z
+static void build_positions(const int* zbuffer, int w, int h, int res, Vec3f camera_pos, const Planes& p, std::vector<float>& px, std::vector<float>& py, std::vector<float>& pz, ThreadPool* pool) {
+	float inv_scale = 2.f/w;
+	float inv_c = 1.f/camera_pos.z;
+	px.assign(p.size(), 0);
+	py.assign(p.size(), 0);
+	pz.assign(p.size(), SSAO_EMPTY);
+	parallel_for(pool, p.h, SSAO_BAND, [&](int y0, int y1) {
+		std::vector<float> depth(p.w);
+		for (int cy=y0; cy<y1; cy++) {
+			int sy = std::min(h-1, cy*res);
+			const int* zrow = zbuffer+(size_t)sy*w;
+			float* x = p.row(px, cy);
+			float* y = p.row(py, cy);
+			float* z = p.row(pz, cy);
+			for (int cx=0; cx<p.w; cx++) depth[cx] = zrow[std::min(w-1, cx*res)];
+			float ny = sy*inv_scale-1;
+			for (int cx=0; cx<p.w; cx++) {
+				float nz = depth[cx]*inv_scale-1;
+				float zc = nz/(1+nz*inv_c);
+				float k = 1-zc*inv_c;
+				bool drawn = depth[cx]>std::numeric_limits<int>::min()+1.f;
+				x[cx] = drawn ? (cx*res*inv_scale-1)*k : 0;
+				y[cx] = drawn ? ny*k : 0;
+				z[cx] = drawn ? zc : SSAO_EMPTY;
+			}
+		}
+	});
+}
+
+// normals from the positions step pixels away, using whichever side is closer in depth so edges don't smear.
+// a step of one pixel would mostly see the zbuffer's integer rounding. they come out facing the camera
+static void build_normals(const Planes& p, int step, const std::vector<float>& px, const std::vector<float>& py, const std::vector<float>& pz, Vec3f camera_pos,
+	std::vector<float>& nx, std::vector<float>& ny, std::vector<float>& nz, ThreadPool* pool) {
+	nx.assign(p.size(), 0);
+	ny.assign(p.size(), 0);
+	nz.assign(p.size(), 1);
+	parallel_for(pool, p.h, SSAO_BAND, [&](int y0, int y1) {
+		for (int y=y0; y<y1; y++) {
+			const float *x0 = p.row(px, y), *y0r = p.row(py, y), *z0 = p.row(pz, y);
+			const float *xu = p.row(px, y-step), *yu = p.row(py, y-step), *zu = p.row(pz, y-step);
+			const float *xd = p.row(px, y+step), *yd = p.row(py, y+step), *zd = p.row(pz, y+step);
+			float *ox = p.row(nx, y), *oy = p.row(ny, y), *oz = p.row(nz, y);
+			for (int x=0; x<p.w; x++) {
+				bool right = std::abs(z0[x+step]-z0[x]) < std::abs(z0[x]-z0[x-step]);
+				float ax = right ? x0[x+step]-x0[x] : x0[x]-x0[x-step];
+				float ay = right ? y0r[x+step]-y0r[x] : y0r[x]-y0r[x-step];
+				float az = right ? z0[x+step]-z0[x] : z0[x]-z0[x-step];
+				bool down = std::abs(zd[x]-z0[x]) < std::abs(z0[x]-zu[x]);
+				float bx = down ? xd[x]-x0[x] : x0[x]-xu[x];
+				float by = down ? yd[x]-y0r[x] : y0r[x]-yu[x];
+				float bz = down ? zd[x]-z0[x] : z0[x]-zu[x];
+				float cx = ay*bz-az*by, cy = az*bx-ax*bz, cz = ax*by-ay*bx;
+				// flip towards the camera, then normalize
+				float facing = cx*(camera_pos.x-x0[x]) + cy*(camera_pos.y-y0r[x]) + cz*(camera_pos.z-z0[x]);
+				float len = std::sqrt(cx*cx + cy*cy + cz*cz);
+				float inv = len>0 ? (facing<0 ? -1.f : 1.f)/len : 0;
+				ox[x] = cx*inv;
+				oy[x] = cy*inv;
+				oz[x] = cz*inv;
+			}
+		}
+	});
+}
+
+// one sample offset at a time across a whole row. the offsets are the same for every pixel, so each
+// sample is a contiguous run of the padded position rows and the inner loop is plain simd arithmetic.
+// even rows take the even samples of the spiral and odd rows the odd ones, the vertical blur evens it out
+static void occlusion(const Planes& p, const std::vector<float>& px, const std::vector<float>& py, const std::vector<float>& pz,
+	const std::vector<float>& nx, const std::vector<float>& ny, const std::vector<float>& nz, int radius, std::vector<float>& ao, ThreadPool* pool) {
+	int ox[SSAO_SAMPLES], oy[SSAO_SAMPLES];
+	for (int k=0; k<SSAO_SAMPLES; k++) {
+		// golden angle spiral, denser near the middle
+		float r = radius*std::sqrt((k+.5f)/SSAO_SAMPLES);
+		float a = k*2.39996f;
+		ox[k] = (int)std::lround(r*std::cos(a));
+		oy[k] = (int)std::lround(r*std::sin(a));
+	}
+	// alchemy style estimator: sum of max(0, v*n - bias)/(v*v + eps) over the samples. no sqrt, so the
+	// compiler can vectorize it without breaking errno semantics
+	float eps = SSAO_FALLOFF*SSAO_FALLOFF*.01f;
+	float k = SSAO_STRENGTH*SSAO_FALLOFF/(SSAO_SAMPLES/2);
+	ao.assign(p.size(), 1);
+	parallel_for(pool, p.h, SSAO_BAND, [&](int y0, int y1) {
+		std::vector<float> acc(p.w);
+		for (int y=y0; y<y1; y++) {
+			const float *cx = p.row(px, y), *cy = p.row(py, y), *cz = p.row(pz, y);
+			const float *n0 = p.row(nx, y), *n1 = p.row(ny, y), *n2 = p.row(nz, y);
+			std::fill(acc.begin(), acc.end(), 0.f);
+			float* a = acc.data();
+			for (int s=y&1; s<SSAO_SAMPLES; s+=2) {
+				const float *sx = p.row(px, y+oy[s])+ox[s], *sy = p.row(py, y+oy[s])+ox[s], *sz = p.row(pz, y+oy[s])+ox[s];
+				for (int x=0; x<p.w; x++) {
+					float vx = sx[x]-cx[x], vy = sy[x]-cy[x], vz = sz[x]-cz[x];
+					float d2 = vx*vx + vy*vy + vz*vz;
+					float vn = vx*n0[x] + vy*n1[x] + vz*n2[x] - SSAO_BIAS;
+					vn = vn>0 ? vn : 0;
+					a[x] += vn/(d2+eps);
+				}
+			}
+			float* out = p.row(ao, y);
+			for (int x=0; x<p.w; x++) {
+				float v = 1 - a[x]*k;
+				v = v<0 ? 0 : v;
+				out[x] = cz[x]==SSAO_EMPTY ? 1 : v;
+			}
+		}
+	});
+}
+
+// separable blur that doesn't mix across depth edges. (dx, dy) is the direction of this pass. like the
+// sampling, each tap is a contiguous run of the padded planes
+static void bilateral(const Planes& p, const std::vector<float>& pz, const std::vector<float>& in, std::vector<float>& out, int dx, int dy, ThreadPool* pool) {
+	float gauss[2*SSAO_BLUR+1];
+	for (int k=-SSAO_BLUR; k<=SSAO_BLUR; k++) gauss[k+SSAO_BLUR] = std::exp(-2.f*k*k/(SSAO_BLUR*SSAO_BLUR));
+	float inv_sigma = 2.f/SSAO_FALLOFF;
+	out.assign(p.size(), 1);
+	parallel_for(pool, p.h, SSAO_BAND, [&](int y0, int y1) {
+		std::vector<float> sum(p.w), weight(p.w);
+		for (int y=y0; y<y1; y++) {
+			const float* z = p.row(pz, y);
+			std::fill(sum.begin(), sum.end(), 0.f);
+			std::fill(weight.begin(), weight.end(), 0.f);
+			float *s = sum.data(), *wt = weight.data();
+			for (int k=-SSAO_BLUR; k<=SSAO_BLUR; k++) {
+				const float* tz = p.row(pz, y+k*dy)+k*dx;
+				const float* tv = p.row(in, y+k*dy)+k*dx;
+				float g = gauss[k+SSAO_BLUR];
+				for (int x=0; x<p.w; x++) {
+					float dz = (tz[x]-z[x])*inv_sigma;
+					float wk = g/(1+dz*dz);
+					s[x] += tv[x]*wk;
+					wt[x] += wk;
+				}
+			}
+			float* o = p.row(out, y);
+			for (int x=0; x<p.w; x++) o[x] = s[x]/wt[x];
+		}
+	});
+}
+
+void ssao(const int* zbuffer, int w, int h, Vec3f camera_pos, std::vector<float>& ao, bool half_res, ThreadPool* pool) {
+	TRACE_SCOPE("ssao");
+	int res = half_res ? 2 : 1;
+	Planes p;
+	p.w = (w+res-1)/res;
+	p.h = (h+res-1)/res;
+	int radius = std::max(1, (int)std::ceil(SSAO_RADIUS*p.w));
+	int step = std::max(1, (int)std::lround(SSAO_NORMAL_STEP*p.w));
+	p.pad = std::max(std::max(radius, step), SSAO_BLUR);
+	p.stride = p.w+2*p.pad;
+	std::vector<float> px, py, pz, nx, ny, nz, raw, tmp;
+	build_positions(zbuffer, w, h, res, camera_pos, p, px, py, pz, pool);
+	build_normals(p, step, px, py, pz, camera_pos, nx, ny, nz, pool);
+	occlusion(p, px, py, pz, nx, ny, nz, radius, raw, pool);
+	bilateral(p, pz, raw, tmp, 1, 0, pool);
+	bilateral(p, pz, tmp, raw, 0, 1, pool);
+
+	ao.resize((size_t)w*h);
+	if (res==1) {
+		for (int y=0; y<h; y++) std::copy(p.row(raw, y), p.row(raw, y)+w, ao.data()+(size_t)y*w);
+		return;
+	}
+
+	// upsample: bilinear over the nearest half res values, weighted down where their depth differs. depths are
+	// compared straight from the zbuffer so there's no per pixel divide to get back to view space, and even and
+	// odd columns are separate contiguous runs so both loops vectorize
+	float inv_sigma = 2.f/SSAO_FALLOFF/(w/2);
+	parallel_for(pool, h, SSAO_BAND, [&](int y0, int y1) {
+		int hw = p.w;
+		std::vector<float> even(hw), odd(hw), ze(hw), zo(hw), z0(hw+1), z1(hw+1);
+		for (int y=y0; y<y1; y++) {
+			int hy = y/2;
+			float ty = (y&1)*.5f;
+			const int* zrow = zbuffer+(size_t)y*w;
+			const int* zr0 = zbuffer+(size_t)std::min(h-1, hy*2)*w;
+			const int* zr1 = zbuffer+(size_t)std::min(h-1, hy*2+2)*w;
+			const float *a0 = p.row(raw, hy), *a1 = p.row(raw, hy+1);
+			for (int hx=0; hx<=hw; hx++) {
+				int x = std::min(w-1, hx*2);
+				z0[hx] = zr0[x];
+				z1[hx] = zr1[x];
+			}
+			for (int hx=0; hx<hw; hx++) {
+				ze[hx] = zrow[hx*2];
+				zo[hx] = zrow[std::min(w-1, hx*2+1)];
+			}
+			for (int hx=0; hx<hw; hx++) {
+				float d0 = (z0[hx]-ze[hx])*inv_sigma, d2 = (z1[hx]-ze[hx])*inv_sigma;
+				float w0 = (1-ty+1e-3f)/(1+d0*d0), w2 = (ty+1e-3f)/(1+d2*d2);
+				even[hx] = (a0[hx]*w0 + a1[hx]*w2)/(w0+w2);
+			}
+			for (int hx=0; hx<hw; hx++) {
+				float d0 = (z0[hx]-zo[hx])*inv_sigma, d1 = (z0[hx+1]-zo[hx])*inv_sigma;
+				float d2 = (z1[hx]-zo[hx])*inv_sigma, d3 = (z1[hx+1]-zo[hx])*inv_sigma;
+				float w0 = (1-ty+1e-3f)/(1+d0*d0), w1 = (1-ty+1e-3f)/(1+d1*d1);
+				float w2 = (ty+1e-3f)/(1+d2*d2), w3 = (ty+1e-3f)/(1+d3*d3);
+				odd[hx] = (a0[hx]*w0 + a0[hx+1]*w1 + a1[hx]*w2 + a1[hx+1]*w3)/(w0+w1+w2+w3);
+			}
+			float* out = ao.data()+(size_t)y*w;
+			for (int x=0; x<w; x++) out[x] = zrow[x]==std::numeric_limits<int>::min() ? 1 : (x&1 ? odd : even)[x/2];
+		}
+	});
+}
+
+void apply_ao(const ImageView& image, const std::vector<float>& ao) {
+	int w = image.get_width(), h = image.get_height(), bpp = image.get_bytespp();
+	if (!image.row(0) || ao.size()<(size_t)w*h) return;
+	for (int y=0; y<h; y++) {
+		unsigned char* p = image.row(y);
+		const float* a = ao.data()+(size_t)y*w;
+		for (int x=0; x<w; x++) {
+			for (int c=0; c<std::min(bpp, 3); c++) {
+				p[x*bpp+c] = (unsigned char)(p[x*bpp+c]*a[x]);
+			}
+		}
+	}
+}
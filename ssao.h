@@ -0,0 +1,30 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_SSAO_H
+#define TATE_SSAO_H
+
+#include <vector>
+#include "tgaimage.h"
+#include "imageview.h"
+#include "geometry.h"
+
+class ThreadPool;
+
+const int SSAO_SAMPLES = 16;
+const float SSAO_RADIUS = .025f;  // sampling radius as a fraction of the image width
+const float SSAO_FALLOFF = .1f;   // world distance at which an occluder only counts half
+const float SSAO_BIAS = .01f;     // world distance above the surface an occluder has to be, stops flat faces shading themselves
+const float SSAO_NORMAL_STEP = .003f; // distance to the neighbours normals are taken from, as a fraction of the image width
+const float SSAO_STRENGTH = 1.5f;
+const int SSAO_BLUR = 4;          // bilateral blur radius, in pixels at the resolution the occlusion is computed at
+
+// ambient occlusion from the zbuffer that render() leaves behind, w*h values from 0 (buried) to 1 (open).
+// positions are rebuilt from depth with the renderer's projection and normals from neighbouring positions.
+// half_res computes it on every other pixel and upsamples with depth weights. rows are spread over pool
+// if there is one
+void ssao(const int* zbuffer, int w, int h, Vec3f camera_pos, std::vector<float>& ao, bool half_res=false, ThreadPool* pool=NULL);
+// darkens image by ao
+void apply_ao(const ImageView& image, const std::vector<float>& ao);
+
+#endif // TATE_SSAO_H
@@ -4,6 +4,17 @@
 #include <time.h>
 #include <math.h>
 #include "tgaimage.h"
+#include "imageview.h"
+#include "trace.h"
+#include "threadpool.h"
+
+// whole-image operations split the rows into chunks of about this many bytes for the shared pool
+const int IMAGE_CHUNK_BYTES = 1<<18;
+
+static int rows_per_chunk(int width, int bytespp) {
+	int row = width*bytespp;
+	return row>0 ? std::max(1, IMAGE_CHUNK_BYTES/row) : 1;
+}
 
 TGAImage::TGAImage() : data(NULL), width(0), height(0), bytespp(0) {
 }
@@ -40,7 +51,61 @@ TGAImage & TGAImage::operator =(const TGAImage &img) {
 	return *this;
 }
 
-bool TGAImage::read_tga_file(const char *filename) {
+// decodes the rle packets into dst, row by row in dst's order
+static bool load_rle_data(std::ifstream &in, const ImageView& dst) {
+	int width = dst.get_width(), bytespp = dst.get_bytespp();
+	unsigned long pixelcount = (unsigned long)width*dst.get_height();
+	unsigned long currentpixel = 0;
+	unsigned char *p = NULL;
+	TGAColor colorbuffer;
+	// next pixel's bytes, starting a new row of dst every width pixels
+	auto put = [&](const unsigned char *c) {
+		if (currentpixel%width==0) p = dst.row(currentpixel/width);
+		for (int t=0; t<bytespp; t++) *p++ = c[t];
+		currentpixel++;
+	};
+	do {
+		unsigned char chunkheader = 0;
+		chunkheader = in.get();
+		if (!in.good()) {
+			std::cerr << "an error occured while reading the data\n";
+			return false;
+		}
+		if (chunkheader<128) {
+			chunkheader++;
+			for (int i=0; i<chunkheader; i++) {
+				in.read((char *)colorbuffer.raw, bytespp);
+				if (!in.good()) {
+					std::cerr << "an error occured while reading the header\n";
+					return false;
+				}
+				if (currentpixel>=pixelcount) {
+					std::cerr << "Too many pixels read\n";
+					return false;
+				}
+				put(colorbuffer.raw);
+			}
+		} else {
+			chunkheader -= 127;
+			in.read((char *)colorbuffer.raw, bytespp);
+			if (!in.good()) {
+				std::cerr << "an error occured while reading the header\n";
+				return false;
+			}
+			for (int i=0; i<chunkheader; i++) {
+				if (currentpixel>=pixelcount) {
+					std::cerr << "Too many pixels read\n";
+					return false;
+				}
+				put(colorbuffer.raw);
+			}
+		}
+	} while (currentpixel < pixelcount);
+	return true;
+}
+
+bool TGAImage::read_tga_file(const char *filename, bool bottom_up) {
+	TRACE_SCOPE("decode tga");
 	if (data) delete [] data;
 	data = NULL;
 	std::ifstream in;
@@ -67,15 +132,20 @@ bool TGAImage::read_tga_file(const char *filename) {
 	}
 	unsigned long nbytes = bytespp*width*height;
 	data = new unsigned char[nbytes];
+	// rows are decoded straight into the order asked for. tga files are bottom-up unless the descriptor
+	// says otherwise, so a bottom_up read of a bottom-up file is one contiguous read with no flip
+	bool file_bottom_up = !(header.imagedescriptor & 0x20);
+	ImageView dst = file_bottom_up==bottom_up ? ImageView(*this) : ImageView(*this).flipped();
 	if (3==header.datatypecode || 2==header.datatypecode) {
-		in.read((char *)data, nbytes);
+		if (dst.contiguous()) in.read((char *)data, nbytes);
+		for (int y=0; y<height && !dst.contiguous() && in.good(); y++) in.read((char *)dst.row(y), (size_t)width*bytespp);
 		if (!in.good()) {
 			in.close();
 			std::cerr << "an error occured while reading the data\n";
 			return false;
 		}
 	} else if (10==header.datatypecode||11==header.datatypecode) {
-		if (!load_rle_data(in)) {
+		if (!load_rle_data(in, dst)) {
 			in.close();
 			std::cerr << "an error occured while reading the data\n";
 			return false;
@@ -85,9 +155,6 @@ bool TGAImage::read_tga_file(const char *filename) {
 		std::cerr << "unknown file format " << (int)header.datatypecode << "\n";
 		return false;
 	}
-	if (!(header.imagedescriptor & 0x20)) {
-		flip_vertically();
-	}
 	if (header.imagedescriptor & 0x10) {
 		flip_horizontally();
 	}
@@ -96,56 +163,56 @@ bool TGAImage::read_tga_file(const char *filename) {
 	return true;
 }
 
-bool TGAImage::load_rle_data(std::ifstream &in) {
-	unsigned long pixelcount = width*height;
-	unsigned long currentpixel = 0;
-	unsigned long currentbyte  = 0;
-	TGAColor colorbuffer;
-	do {
-		unsigned char chunkheader = 0;
-		chunkheader = in.get();
-		if (!in.good()) {
-			std::cerr << "an error occured while reading the data\n";
-			return false;
-		}
-		if (chunkheader<128) {
-			chunkheader++;
-			for (int i=0; i<chunkheader; i++) {
-				in.read((char *)colorbuffer.raw, bytespp);
-				if (!in.good()) {
-					std::cerr << "an error occured while reading the header\n";
-					return false;
-				}
-				for (int t=0; t<bytespp; t++)
-					data[currentbyte++] = colorbuffer.raw[t];
-				currentpixel++;
-				if (currentpixel>pixelcount) {
-					std::cerr << "Too many pixels read\n";
-					return false;
-				}
+// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
+// packets never cross a row, so each one is a contiguous run of the view's row
+static bool unload_rle_data(std::ofstream &out, const ConstImageView& view) {
+	const unsigned char max_chunk_length = 128;
+	int width = view.get_width(), bytespp = view.get_bytespp();
+	unsigned long npixels = (unsigned long)width*view.get_height();
+	unsigned long curpix = 0;
+	while (curpix<npixels) {
+		const unsigned char *data = view.row(curpix/width);
+		unsigned long rowend = (curpix/width+1)*width;
+		unsigned long chunkstart = (curpix%width)*bytespp;
+		unsigned long curbyte = chunkstart;
+		unsigned char run_length = 1;
+		bool raw = true;
+		while (curpix+run_length<rowend && run_length<max_chunk_length) {
+			bool succ_eq = true;
+			for (int t=0; succ_eq && t<bytespp; t++) {
+				succ_eq = (data[curbyte+t]==data[curbyte+t+bytespp]);
 			}
-		} else {
-			chunkheader -= 127;
-			in.read((char *)colorbuffer.raw, bytespp);
-			if (!in.good()) {
-				std::cerr << "an error occured while reading the header\n";
-				return false;
+			curbyte += bytespp;
+			if (1==run_length) {
+				raw = !succ_eq;
 			}
-			for (int i=0; i<chunkheader; i++) {
-				for (int t=0; t<bytespp; t++)
-					data[currentbyte++] = colorbuffer.raw[t];
-				currentpixel++;
-				if (currentpixel>pixelcount) {
-					std::cerr << "Too many pixels read\n";
-					return false;
-				}
+			if (raw && succ_eq) {
+				run_length--;
+				break;
 			}
+			if (!raw && !succ_eq) {
+				break;
+			}
+			run_length++;
 		}
-	} while (currentpixel < pixelcount);
+		curpix += run_length;
+		out.put(raw?run_length-1:run_length+127);
+		if (!out.good()) {
+			std::cerr << "can't dump the tga file\n";
+			return false;
+		}
+		out.write((char *)(data+chunkstart), (raw?run_length*bytespp:bytespp));
+		if (!out.good()) {
+			std::cerr << "can't dump the tga file\n";
+			return false;
+		}
+	}
 	return true;
 }
 
-bool TGAImage::write_tga_file(const char *filename, bool rle) {
+bool write_tga_file(const ConstImageView& view, const char *filename, bool rle) {
+	TRACE_SCOPE("write tga");
+	int width = view.get_width(), height = view.get_height(), bytespp = view.get_bytespp();
 	unsigned char developer_area_ref[4] = {0, 0, 0, 0};
 	unsigned char extension_area_ref[4] = {0, 0, 0, 0};
 	unsigned char footer[18] = {'T','R','U','E','V','I','S','I','O','N','-','X','F','I','L','E','.','\0'};
@@ -161,7 +228,7 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 	header.bitsperpixel = bytespp<<3;
 	header.width  = width;
 	header.height = height;
-	header.datatypecode = (bytespp==GRAYSCALE?(rle?11:3):(rle?10:2));
+	header.datatypecode = (bytespp==TGAImage::GRAYSCALE?(rle?11:3):(rle?10:2));
 	header.imagedescriptor = 0x20; // top-left origin
 	out.write((char *)&header, sizeof(header));
 	if (!out.good()) {
@@ -170,14 +237,15 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 		return false;
 	}
 	if (!rle) {
-		out.write((char *)data, width*height*bytespp);
+		// rows go out top to bottom in the view's order, whichever way they lie in memory
+		for (int y=0; y<height && out.good(); y++) out.write((const char *)view.row(y), (size_t)width*bytespp);
 		if (!out.good()) {
 			std::cerr << "can't unload raw data\n";
 			out.close();
 			return false;
 		}
 	} else {
-		if (!unload_rle_data(out)) {
+		if (!unload_rle_data(out, view)) {
 			out.close();
 			std::cerr << "can't unload rle data\n";
 			return false;
@@ -205,50 +273,12 @@ bool TGAImage::write_tga_file(const char *filename, bool rle) {
 	return true;
 }
 
-// TODO: it is not necessary to break a raw chunk for two equal pixels (for the matter of the resulting size)
-bool TGAImage::unload_rle_data(std::ofstream &out) {
-	const unsigned char max_chunk_length = 128;
-	unsigned long npixels = width*height;
-	unsigned long curpix = 0;
-	while (curpix<npixels) {
-		unsigned long chunkstart = curpix*bytespp;
-		unsigned long curbyte = curpix*bytespp;
-		unsigned char run_length = 1;
-		bool raw = true;
-		while (curpix+run_length<npixels && run_length<max_chunk_length) {
-			bool succ_eq = true;
-			for (int t=0; succ_eq && t<bytespp; t++) {
-				succ_eq = (data[curbyte+t]==data[curbyte+t+bytespp]);
-			}
-			curbyte += bytespp;
-			if (1==run_length) {
-				raw = !succ_eq;
-			}
-			if (raw && succ_eq) {
-				run_length--;
-				break;
-			}
-			if (!raw && !succ_eq) {
-				break;
-			}
-			run_length++;
-		}
-		curpix += run_length;
-		out.put(raw?run_length-1:run_length+127);
-		if (!out.good()) {
-			std::cerr << "can't dump the tga file\n";
-			return false;
-		}
-		out.write((char *)(data+chunkstart), (raw?run_length*bytespp:bytespp));
-		if (!out.good()) {
-			std::cerr << "can't dump the tga file\n";
-			return false;
-		}
-	}
-	return true;
+bool TGAImage::write_tga_file(const char *filename, bool rle) {
+	if (!data) return false;
+	return ::write_tga_file(ConstImageView(*this), filename, rle);
 }
 
-TGAColor TGAImage::get(int x, int y) {
+TGAColor TGAImage::get(int x, int y) const {
 	if (!data || x<0 || y<0 || x>=width || y>=height) {
 		return TGAColor();
 	}
@@ -263,45 +293,53 @@ bool TGAImage::set(int x, int y, TGAColor c) {
 	return true;
 }
 
-int TGAImage::get_bytespp() {
+int TGAImage::get_bytespp() const {
 	return bytespp;
 }
 
-int TGAImage::get_width() {
+int TGAImage::get_width() const {
 	return width;
 }
 
-int TGAImage::get_height() {
+int TGAImage::get_height() const {
 	return height;
 }
 
+// mirrors each row in place, a pixel is BPP bytes so the swaps compile to straight moves
+template <int BPP> static void mirror_rows(unsigned char *data, int width, int y0, int y1) {
+	for (int j=y0; j<y1; j++) {
+		unsigned char *row = data+(size_t)j*width*BPP;
+		for (int i=0, k=width-1; i<k; i++, k--) {
+			for (int c=0; c<BPP; c++) std::swap(row[i*BPP+c], row[k*BPP+c]);
+		}
+	}
+}
+
 bool TGAImage::flip_horizontally() {
+	TRACE_SCOPE("flip horizontally");
 	if (!data) return false;
-	int half = width>>1;
-	for (int i=0; i<half; i++) {
-		for (int j=0; j<height; j++) {
-			TGAColor c1 = get(i, j);
-			TGAColor c2 = get(width-1-i, j);
-			set(i, j, c2);
-			set(width-1-i, j, c1);
+	parallel_for(&shared_pool(), height, rows_per_chunk(width, bytespp), [this](int y0, int y1) {
+		switch (bytespp) {
+		case GRAYSCALE: mirror_rows<GRAYSCALE>(data, width, y0, y1); break;
+		case RGB:       mirror_rows<RGB>(data, width, y0, y1); break;
+		case RGBA:      mirror_rows<RGBA>(data, width, y0, y1); break;
 		}
-	}
+	});
 	return true;
 }
 
+// swaps row j with row height-1-j directly, no scratch line
 bool TGAImage::flip_vertically() {
+	TRACE_SCOPE("flip vertically");
 	if (!data) return false;
-	unsigned long bytes_per_line = width*bytespp;
-	unsigned char *line = new unsigned char[bytes_per_line];
-	int half = height>>1;
-	for (int j=0; j<half; j++) {
-		unsigned long l1 = j*bytes_per_line;
-		unsigned long l2 = (height-1-j)*bytes_per_line;
-		memmove((void *)line,      (void *)(data+l1), bytes_per_line);
-		memmove((void *)(data+l1), (void *)(data+l2), bytes_per_line);
-		memmove((void *)(data+l2), (void *)line,      bytes_per_line);
-	}
-	delete [] line;
+	size_t bytes_per_line = (size_t)width*bytespp;
+	parallel_for(&shared_pool(), height>>1, rows_per_chunk(width, bytespp), [this, bytes_per_line](int j0, int j1) {
+		for (int j=j0; j<j1; j++) {
+			unsigned char *l1 = data+j*bytes_per_line;
+			unsigned char *l2 = data+(height-1-j)*bytes_per_line;
+			std::swap_ranges(l1, l1+bytes_per_line, l2);
+		}
+	});
 	return true;
 }
 
@@ -309,11 +347,20 @@ unsigned char *TGAImage::buffer() {
 	return data;
 }
 
+const unsigned char *TGAImage::buffer() const {
+	return data;
+}
+
 void TGAImage::clear() {
-	memset((void *)data, 0, width*height*bytespp);
+	if (!data) return;
+	size_t bytes_per_line = (size_t)width*bytespp;
+	parallel_for(&shared_pool(), height, rows_per_chunk(width, bytespp), [this, bytes_per_line](int y0, int y1) {
+		memset((void *)(data+y0*bytes_per_line), 0, (y1-y0)*bytes_per_line);
+	});
 }
 
 bool TGAImage::scale(int w, int h) {
+	TRACE_SCOPE("scale");
 	if (w<=0 || h<=0 || !data) return false;
 	unsigned char *tdata = new unsigned char[w*h*bytespp];
 	int nscanline = 0;
@@ -67,8 +67,6 @@ protected:
 	int height;
 	int bytespp;
 
-	bool   load_rle_data(std::ifstream &in);
-	bool unload_rle_data(std::ofstream &out);
 public:
 	enum Format {
 		GRAYSCALE=1, RGB=3, RGBA=4
@@ -77,19 +75,25 @@ public:
 	TGAImage();
 	TGAImage(int w, int h, int bpp);
 	TGAImage(const TGAImage &img);
-	bool read_tga_file(const char *filename);
+	// bottom_up puts the picture's bottom row at y=0, the way the rasterizer samples textures
+	bool read_tga_file(const char *filename, bool bottom_up=false);
 	bool write_tga_file(const char *filename, bool rle=true);
+	bool read_qoi_file(const char *filename, bool bottom_up=false);
+	bool write_qoi_file(const char *filename);
+	bool read_file(const char *filename, bool bottom_up=false);
+	bool write_file(const char *filename);
 	bool flip_horizontally();
 	bool flip_vertically();
 	bool scale(int w, int h);
-	TGAColor get(int x, int y);
+	TGAColor get(int x, int y) const;
 	bool set(int x, int y, TGAColor c);
 	~TGAImage();
 	TGAImage & operator =(const TGAImage &img);
-	int get_width();
-	int get_height();
-	int get_bytespp();
+	int get_width() const;
+	int get_height() const;
+	int get_bytespp() const;
 	unsigned char *buffer();
+	const unsigned char *buffer() const;
 	void clear();
 };
 
@@ -0,0 +1,105 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "threadpool.h"
+#include "trace.h"
+
+// the pool whose work() the current thread is running, if any
+static thread_local const ThreadPool* worker_of = NULL;
+
+// nthreads<=0 uses one thread per core
+ThreadPool::ThreadPool(int nthreads) : workers(), tasks(), mutex(), task_ready(), idle(), busy(0), stopping(false) {
+	if (nthreads<=0) nthreads = std::thread::hardware_concurrency();
+	if (nthreads<=0) nthreads = 1;
+	for (int i=0; i<nthreads; i++) {
+		workers.push_back(std::thread(&ThreadPool::work, this));
+	}
+}
+
+// finishes everything already queued, then joins the workers
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	task_ready.notify_all();
+	for (size_t i=0; i<workers.size(); i++) workers[i].join();
+}
+
+void ThreadPool::work() {
+	worker_of = this;
+	trace_thread_name("pool");
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			task_ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (tasks.empty()) return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+			busy++;
+		}
+		task();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			busy--;
+			if (busy==0 && tasks.empty()) idle.notify_all();
+		}
+	}
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	task_ready.notify_one();
+}
+
+// blocks until the queue is empty and no task is running
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this] { return busy==0 && tasks.empty(); });
+}
+
+ThreadPool& shared_pool() {
+	static ThreadPool pool;
+	return pool;
+}
+
+void parallel_for(ThreadPool* pool, int n, int grain, const std::function<void(int, int)>& f) {
+	if (grain<1) grain = 1;
+	int chunks = (n+grain-1)/grain;
+	if (!pool || chunks<=1 || worker_of==pool) {
+		if (n>0) f(0, n);
+		return;
+	}
+	// chunks are handed out from a counter, so a slow thread doesn't hold up a fixed share of the work.
+	// helpers that start after the last chunk is taken return without touching f
+	struct Shared {
+		std::atomic<int> next, done;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	std::shared_ptr<Shared> shared = std::make_shared<Shared>();
+	shared->next = 0;
+	shared->done = 0;
+	const std::function<void(int, int)>* body = &f;
+	auto run = [shared, body, n, grain, chunks]() {
+		for (int c; (c = shared->next++) < chunks; ) {
+			(*body)(c*grain, std::min(n, (c+1)*grain));
+			if (++shared->done==chunks) {
+				std::lock_guard<std::mutex> lock(shared->mutex);
+				shared->finished.notify_all();
+			}
+		}
+	};
+	int helpers = std::min(pool->size(), chunks-1);
+	for (int i=0; i<helpers; i++) pool->submit(run);
+	run();
+	std::unique_lock<std::mutex> lock(shared->mutex);
+	shared->finished.wait(lock, [&] { return shared->done==chunks; });
+}
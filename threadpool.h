@@ -0,0 +1,43 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_THREADPOOL_H
+#define TATE_THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+// fixed set of worker threads pulling tasks off a shared queue
+class ThreadPool {
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable task_ready;
+	std::condition_variable idle;
+	int busy;
+	bool stopping;
+	void work();
+public:
+	ThreadPool(int nthreads=0);
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+	int size() const { return (int)workers.size(); }
+	void submit(std::function<void()> task);
+	void wait();
+};
+
+// one pool for the whole process, started on first use with a thread per core. for whole-image work
+// that doesn't have a pool of its own to run on
+ThreadPool& shared_pool();
+
+// runs f(begin, end) over [0, n) in chunks of grain, on the pool and on the calling thread, and returns
+// once every chunk is done. it only waits for its own chunks so several callers can share a pool. with
+// no pool, a single chunk, or when called from one of the pool's own threads it just runs f(0, n)
+void parallel_for(ThreadPool* pool, int n, int grain, const std::function<void(int, int)>& f);
+
+#endif // TATE_THREADPOOL_H
@@ -0,0 +1,157 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <unistd.h>
+#include "trace.h"
+
+std::atomic<bool> trace_on(false);
+
+// one slot of a ring. seq is the event's index+1 once it's written and 0 while it's being written, so a
+// dump that reads the same seq before and after copying the fields got a whole event
+struct TraceEvent {
+	std::atomic<uint64_t> seq;
+	std::atomic<const char *> name;
+	std::atomic<int64_t> start, dur;
+};
+
+struct TraceRing {
+	int tid;
+	bool in_use;                // a live thread records into it, guarded by rings_mutex
+	std::atomic<const char *> name;
+	std::atomic<uint64_t> head; // events ever written
+	TraceEvent events[TRACE_EVENTS];
+};
+
+// every ring ever registered. they're never freed, so a thread's events are still there after it exits.
+// an exited thread's ring goes to the next thread that starts recording, which carries on in the same
+// track, so there are only ever as many rings as threads recording at once
+static std::mutex rings_mutex;
+static std::vector<TraceRing*> rings;
+
+// hands the ring back when its thread exits
+struct RingOwner {
+	TraceRing* ring;
+	~RingOwner() {
+		if (!ring) return;
+		std::lock_guard<std::mutex> lock(rings_mutex);
+		ring->in_use = false;
+	}
+};
+
+static thread_local RingOwner local_ring = {NULL};
+static thread_local const char *local_name = NULL;
+
+static const std::chrono::steady_clock::time_point trace_epoch = std::chrono::steady_clock::now();
+
+void trace_enable(bool on) {
+	trace_on.store(on, std::memory_order_relaxed);
+}
+
+int64_t trace_clock() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-trace_epoch).count();
+}
+
+static TraceRing* register_ring() {
+	std::lock_guard<std::mutex> lock(rings_mutex);
+	for (size_t i=0; i<rings.size(); i++) {
+		if (rings[i]->in_use) continue;
+		rings[i]->in_use = true;
+		rings[i]->name = local_name;
+		return rings[i];
+	}
+	TraceRing* r = new TraceRing();
+	r->in_use = true;
+	r->name = local_name;
+	r->head = 0;
+	for (int i=0; i<TRACE_EVENTS; i++) r->events[i].seq.store(0, std::memory_order_relaxed);
+	r->tid = (int)rings.size()+1;
+	rings.push_back(r);
+	return r;
+}
+
+void trace_record(const char *name, int64_t start, int64_t end) {
+	TraceRing* r = local_ring.ring;
+	if (!r) r = local_ring.ring = register_ring();
+	uint64_t i = r->head.load(std::memory_order_relaxed);
+	TraceEvent& e = r->events[i & (TRACE_EVENTS-1)];
+	e.seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	e.name.store(name, std::memory_order_relaxed);
+	e.start.store(start, std::memory_order_relaxed);
+	e.dur.store(end-start, std::memory_order_relaxed);
+	e.seq.store(i+1, std::memory_order_release);
+	r->head.store(i+1, std::memory_order_release);
+}
+
+void trace_thread_name(const char *name) {
+	local_name = name;
+	if (local_ring.ring) local_ring.ring->name.store(name, std::memory_order_relaxed);
+}
+
+// chrome wants microseconds, fractions are fine
+static void write_us(std::ostream& out, int64_t ns) {
+	out << ns/1000 << "." << (char)('0'+ns/100%10) << (char)('0'+ns/10%10) << (char)('0'+ns%10);
+}
+
+bool trace_dump(const char *path) {
+	std::ofstream out(path);
+	if (!out.is_open()) {
+		std::cerr << "can't open file " << path << "\n";
+		return false;
+	}
+	std::vector<TraceRing*> snapshot;
+	{
+		std::lock_guard<std::mutex> lock(rings_mutex);
+		snapshot = rings;
+	}
+	int pid = getpid();
+	long written = 0;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	const char *sep = "";
+	for (size_t k=0; k<snapshot.size(); k++) {
+		TraceRing* r = snapshot[k];
+		const char *thread = r->name.load(std::memory_order_relaxed);
+		out << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << r->tid << ",\"args\":{\"name\":\"";
+		if (thread) out << thread;
+		else out << "thread " << r->tid;
+		out << "\"}}";
+		sep = ",\n";
+		uint64_t head = r->head.load(std::memory_order_acquire);
+		for (uint64_t i = head>TRACE_EVENTS ? head-TRACE_EVENTS : 0; i<head; i++) {
+			const TraceEvent& e = r->events[i & (TRACE_EVENTS-1)];
+			if (e.seq.load(std::memory_order_acquire)!=i+1) continue;
+			const char *name = e.name.load(std::memory_order_relaxed);
+			int64_t start = e.start.load(std::memory_order_relaxed), dur = e.dur.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (e.seq.load(std::memory_order_relaxed)!=i+1) continue;
+			out << sep << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << r->tid << ",\"ts\":";
+			write_us(out, start);
+			out << ",\"dur\":";
+			write_us(out, dur);
+			out << "}";
+			written++;
+		}
+	}
+	out << "\n]}\n";
+	out.close();
+	if (!out.good()) {
+		std::cerr << "can't dump the trace file\n";
+		return false;
+	}
+	std::cerr << "# trace: " << written << " events from " << snapshot.size() << " threads in " << path << std::endl;
+	return true;
+}
+
+TraceSession::TraceSession(const std::string& path) : path(path) {
+	trace_enable(true);
+}
+
+TraceSession::~TraceSession() {
+	trace_enable(false);
+	trace_dump(path.c_str());
+}
@@ -0,0 +1,61 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_TRACE_H
+#define TATE_TRACE_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+const int TRACE_EVENTS = 1<<15; // events kept per thread, the oldest are overwritten. a power of two
+
+// scoped timing of pipeline stages, recorded per thread and written out as chrome trace event json, which
+// chrome://tracing and ui.perfetto.dev both open. tracing starts off, and a TRACE_SCOPE costs one relaxed
+// load and a branch until trace_enable(true), so it can stay in the hot paths. scopes go around batches,
+// a whole mesh or a meshlet's faces, not single pixels or triangles
+extern std::atomic<bool> trace_on;
+
+inline bool trace_enabled() { return trace_on.load(std::memory_order_relaxed); }
+void trace_enable(bool on);
+
+// nanoseconds on the clock events are stamped with
+int64_t trace_clock();
+
+// appends one finished event to the calling thread's ring. name must outlive the trace, a string literal.
+// only the owning thread writes its ring and nothing is locked, a thread's first event registers the ring
+void trace_record(const char *name, int64_t start, int64_t end);
+
+// names the calling thread in the trace, eg. "pool". a literal, like event names
+void trace_thread_name(const char *name);
+
+// writes every thread's events so far to path. safe while other threads are recording, an event being
+// overwritten at that moment is left out
+bool trace_dump(const char *path);
+
+// times from construction to the end of the scope, when tracing was on at the start
+class TraceScope {
+	const char *name;
+	int64_t start;
+public:
+	TraceScope(const char *name) : name(name), start(trace_enabled() ? trace_clock() : -1) {}
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+	~TraceScope() { if (start>=0) trace_record(name, start, trace_clock()); }
+};
+
+// turns tracing on for its lifetime and dumps to path at the end
+class TraceSession {
+	std::string path;
+public:
+	TraceSession(const std::string& path);
+	TraceSession(const TraceSession&) = delete;
+	TraceSession& operator=(const TraceSession&) = delete;
+	~TraceSession();
+};
+
+#define TRACE_JOIN2(a, b) a##b
+#define TRACE_JOIN(a, b) TRACE_JOIN2(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_JOIN(trace_scope_, __LINE__)(name)
+
+#endif // TATE_TRACE_H
@@ -0,0 +1,168 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include "tgaimage.h"
+#include "imageview.h"
+#include "trace.h"
+#include "videosink.h"
+
+// the loops below are written branch free over plain byte arrays so the compiler can vectorize them
+
+// packed rgb, in the view's row order
+void to_rgb24(const ConstImageView& img, unsigned char *out) {
+	int w = img.get_width();
+	int h = img.get_height();
+	int bpp = img.get_bytespp();
+	for (int j=0; j<h; j++) {
+		const unsigned char *__restrict src = img.row(j);
+		unsigned char *__restrict dst = out + (size_t)j*w*3;
+		if (bpp==1) {
+			for (int i=0; i<w; i++) {
+				dst[i*3] = dst[i*3+1] = dst[i*3+2] = src[i];
+			}
+		} else if (bpp==3) {
+			for (int i=0; i<w; i++) {
+				dst[i*3] = src[i*3+2];
+				dst[i*3+1] = src[i*3+1];
+				dst[i*3+2] = src[i*3];
+			}
+		} else {
+			for (int i=0; i<w; i++) {
+				dst[i*3] = src[i*4+2];
+				dst[i*3+1] = src[i*4+1];
+				dst[i*3+2] = src[i*4];
+			}
+		}
+	}
+}
+
+// full range bt.601 in 8.8 fixed point. chroma reaches 256 for pure blue (u) and pure red (v), so it's
+// clamped before it's narrowed
+static inline unsigned char luma(int r, int g, int b) {
+	return (unsigned char)((77*r + 150*g + 29*b + 128) >> 8);
+}
+static inline unsigned char clamp_byte(int x) {
+	return (unsigned char)std::min(255, std::max(0, x));
+}
+static inline unsigned char chroma_u(int r, int g, int b) {
+	return clamp_byte(((-43*r - 85*g + 128*b + 128) >> 8) + 128);
+}
+static inline unsigned char chroma_v(int r, int g, int b) {
+	return clamp_byte(((128*r - 107*g - 21*b + 128) >> 8) + 128);
+}
+
+// planar 4:2:0. chroma planes are (w+1)/2 by (h+1)/2, each sample the average of a 2x2 block
+void to_yuv420(const ConstImageView& img, unsigned char *y, unsigned char *u, unsigned char *v) {
+	int w = img.get_width();
+	int h = img.get_height();
+	int bpp = img.get_bytespp();
+	int cw = (w+1)/2;
+	int ch = (h+1)/2;
+	// gray images have the same byte in every channel, otherwise bytes are b,g,r(,a)
+	int ob = 0;
+	int og = bpp==1 ? 0 : 1;
+	int orr = bpp==1 ? 0 : 2;
+
+	for (int j=0; j<h; j++) {
+		const unsigned char *__restrict src = img.row(j);
+		unsigned char *__restrict dst = y + (size_t)j*w;
+		for (int i=0; i<w; i++) {
+			dst[i] = luma(src[i*bpp+orr], src[i*bpp+og], src[i*bpp+ob]);
+		}
+	}
+	for (int cj=0; cj<ch; cj++) {
+		int j0 = cj*2;
+		int j1 = j0+1<h ? j0+1 : j0;
+		const unsigned char *__restrict row0 = img.row(j0);
+		const unsigned char *__restrict row1 = img.row(j1);
+		unsigned char *__restrict du = u + (size_t)cj*cw;
+		unsigned char *__restrict dv = v + (size_t)cj*cw;
+		for (int ci=0; ci<w/2; ci++) {
+			int p0 = ci*2*bpp, p1 = p0+bpp;
+			int r = (row0[p0+orr] + row0[p1+orr] + row1[p0+orr] + row1[p1+orr] + 2) >> 2;
+			int g = (row0[p0+og] + row0[p1+og] + row1[p0+og] + row1[p1+og] + 2) >> 2;
+			int b = (row0[p0+ob] + row0[p1+ob] + row1[p0+ob] + row1[p1+ob] + 2) >> 2;
+			du[ci] = chroma_u(r, g, b);
+			dv[ci] = chroma_v(r, g, b);
+		}
+		if (w&1) {
+			int p = (w-1)*bpp;
+			int r = (row0[p+orr] + row1[p+orr] + 1) >> 1;
+			int g = (row0[p+og] + row1[p+og] + 1) >> 1;
+			int b = (row0[p+ob] + row1[p+ob] + 1) >> 1;
+			du[cw-1] = chroma_u(r, g, b);
+			dv[cw-1] = chroma_v(r, g, b);
+		}
+	}
+}
+
+VideoSink::VideoSink(const char *path, Format format, int width, int height, int fps)
+	: fd(-1), owns_fd(false), format(format), width(width), height(height), fps(fps), nframes(0), buf() {
+	if (!strcmp(path, "-")) {
+		fd = STDOUT_FILENO;
+	} else {
+		// a named pipe blocks here until somebody opens it for reading
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		owns_fd = true;
+		if (fd<0) {
+			std::cerr << "can't open " << path << ": " << strerror(errno) << "\n";
+			return;
+		}
+	}
+	if (format==Y4M) {
+		std::string header = "YUV4MPEG2 W" + std::to_string(width) + " H" + std::to_string(height)
+			+ " F" + std::to_string(fps) + ":1 Ip A1:1 C420jpeg\n";
+		write_all((const unsigned char *)header.data(), header.size());
+		buf.resize((size_t)width*height + 2*(size_t)((width+1)/2)*((height+1)/2));
+	} else {
+		buf.resize((size_t)width*height*3);
+	}
+}
+
+VideoSink::~VideoSink() {
+	if (owns_fd && fd>=0) close(fd);
+}
+
+bool VideoSink::write_all(const unsigned char *p, size_t n) {
+	while (fd>=0 && n>0) {
+		ssize_t k = write(fd, p, n);
+		if (k<0 && errno==EINTR) continue;
+		if (k<=0) {
+			std::cerr << "can't write frame: " << strerror(errno) << "\n";
+			if (owns_fd) close(fd);
+			fd = -1;
+			return false;
+		}
+		p += k;
+		n -= k;
+	}
+	return fd>=0;
+}
+
+bool VideoSink::write_frame(const ConstImageView& frame) {
+	TRACE_SCOPE("write frame");
+	if (fd<0) return false;
+	if (frame.get_width()!=width || frame.get_height()!=height || !frame.row(0)) {
+		std::cerr << "frame is " << frame.get_width() << "x" << frame.get_height() << ", sink expects " << width << "x" << height << "\n";
+		return false;
+	}
+	if (format==Y4M) {
+		static const unsigned char frame_header[] = {'F','R','A','M','E','\n'};
+		if (!write_all(frame_header, sizeof(frame_header))) return false;
+		size_t ysize = (size_t)width*height;
+		size_t csize = (size_t)((width+1)/2)*((height+1)/2);
+		to_yuv420(frame, &buf[0], &buf[ysize], &buf[ysize+csize]);
+	} else {
+		to_rgb24(frame, &buf[0]);
+	}
+	if (!write_all(&buf[0], buf.size())) return false;
+	nframes++;
+	return true;
+}
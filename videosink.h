@@ -0,0 +1,36 @@
+// Author: Tate Maguire
+// October 19, 2026
+
+#ifndef TATE_VIDEOSINK_H
+#define TATE_VIDEOSINK_H
+
+#include <vector>
+#include "imageview.h"
+
+void to_rgb24(const ConstImageView& img, unsigned char *out);
+void to_yuv420(const ConstImageView& img, unsigned char *y, unsigned char *u, unsigned char *v);
+
+// streams frames to stdout ("-"), a file or a named pipe as packed rgb24 or yuv4mpeg2 (4:2:0, full range bt.601).
+// frames go out in the view's row order, so a renderer's bottom-up image is passed through flipped(), like
+// for write_file()
+class VideoSink {
+public:
+	enum Format { RAW_RGB, Y4M };
+	VideoSink(const char *path, Format format, int width, int height, int fps=25);
+	VideoSink(const VideoSink&) = delete;
+	VideoSink& operator=(const VideoSink&) = delete;
+	~VideoSink();
+	bool write_frame(const ConstImageView& frame);
+	bool good() const { return fd>=0; }
+	int frames() const { return nframes; }
+private:
+	int fd;
+	bool owns_fd;
+	Format format;
+	int width, height, fps;
+	int nframes;
+	std::vector<unsigned char> buf; // one converted frame, reused
+	bool write_all(const unsigned char *p, size_t n);
+};
+
+#endif // TATE_VIDEOSINK_H